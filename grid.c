@@ -0,0 +1,69 @@
+#include "grid.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void grid_free(struct grid* grid)
+{
+	free(grid->cell_start);
+	free(grid->cell_items);
+	free(grid->item_cell);
+	grid->cell_start = NULL;
+	grid->cell_items = NULL;
+	grid->item_cell = NULL;
+	grid->cell_capacity = 0;
+	grid->item_capacity = 0;
+}
+
+int grid_resize(struct grid* grid, double minx, double miny, double width, double height, int count, int per_cell)
+{
+	int cells = count / per_cell > 0 ? count / per_cell : 1;
+	double side = sqrt(width * height / cells);
+	// the points are on a line
+	if (side <= 0)
+		side = (width > height ? width : height) / cells;
+	if (side <= 0)
+		side = 1;
+	grid->minx = minx;
+	grid->miny = miny;
+	grid->cell = side;
+	grid->cols = (int)(width / side) + 1;
+	grid->rows = (int)(height / side) + 1;
+
+	int ncells = grid->cols * grid->rows;
+	if (ncells + 1 > grid->cell_capacity) {
+		int* cell_start = realloc(grid->cell_start, sizeof(int) * (ncells + 1));
+		if (!cell_start)
+			return -1;
+		grid->cell_start = cell_start;
+		grid->cell_capacity = ncells + 1;
+	}
+	if (count > grid->item_capacity) {
+		int* cell_items = realloc(grid->cell_items, sizeof(int) * count);
+		if (!cell_items)
+			return -1;
+		grid->cell_items = cell_items;
+		int* item_cell = realloc(grid->item_cell, sizeof(int) * count);
+		if (!item_cell)
+			return -1;
+		grid->item_cell = item_cell;
+		grid->item_capacity = count;
+	}
+	return 0;
+}
+
+void grid_fill(struct grid* grid, int count)
+{
+	int ncells = grid->cols * grid->rows;
+	memset(grid->cell_start, 0, sizeof(int) * (ncells + 1));
+	for (int i = 0; i < count; i++)
+		grid->cell_start[grid->item_cell[i] + 1]++;
+	for (int c = 0; c < ncells; c++)
+		grid->cell_start[c + 1] += grid->cell_start[c];
+	for (int i = 0; i < count; i++)
+		grid->cell_items[grid->cell_start[grid->item_cell[i]]++] = i;
+	// cell_start has been shifted by one cell while filling
+	for (int c = ncells; c > 0; c--)
+		grid->cell_start[c] = grid->cell_start[c - 1];
+	grid->cell_start[0] = 0;
+}
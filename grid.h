@@ -0,0 +1,103 @@
+#ifndef GRID_H_
+#define GRID_H_
+
+/**
+ * Uniform grid index of points in the plane, the items in cell c are
+ * cell_items[cell_start[c] ... cell_start[c + 1] - 1].
+ *
+ * The grid is filled in two steps: grid_resize sets the cells over a
+ * bounding box, then the caller stores the cell of every item (see
+ * grid_cell) in item_cell and calls grid_fill. The buffers are kept from
+ * one build to the next when large enough.
+ * */
+struct grid {
+	double minx;
+	double miny;
+	double cell; // side of the cells
+	int cols;
+	int rows;
+	int* cell_start; // cols * rows + 1
+	int* cell_items;
+	int* item_cell;
+	int cell_capacity;
+	int item_capacity;
+};
+
+void grid_free(struct grid* grid);
+
+/**
+ * Cells over the box [minx, minx + width] x [miny, miny + height], with
+ * about per_cell of the count items in each one
+ * */
+int grid_resize(struct grid* grid, double minx, double miny, double width, double height, int count, int per_cell);
+
+/**
+ * returns the cell of (x, y), points outside the box are in the nearest
+ * border cell
+ * */
+static inline int grid_cell(const struct grid* grid, double x, double y, int* col, int* row)
+{
+	int c = (int)((x - grid->minx) / grid->cell);
+	int r = (int)((y - grid->miny) / grid->cell);
+	*col = c < 0 ? 0 : (c >= grid->cols ? grid->cols - 1 : c);
+	*row = r < 0 ? 0 : (r >= grid->rows ? grid->rows - 1 : r);
+	return *row * grid->cols + *col;
+}
+
+/**
+ * Index items 0 ... count - 1 in the cells item_cell[0 ... count - 1]
+ * */
+void grid_fill(struct grid* grid, int count);
+
+/**
+ * Cells at Chebyshev distance ring from (col, row), the border of the
+ * square of side 2 ring + 1, visited with
+ *
+ *   grid_ring_start(&it, col, row, ring);
+ *   while ((cell = grid_ring_next(grid, &it)) >= 0)
+ *
+ * The points in the cells of the next rings are farther than
+ * ring * grid->cell from any point of cell (col, row).
+ * */
+struct grid_ring {
+	int col;
+	int row;
+	int ring;
+	int r;
+	int c;
+};
+
+static inline void grid_ring_start(struct grid_ring* it, int col, int row, int ring)
+{
+	it->col = col;
+	it->row = row;
+	it->ring = ring;
+	it->r = row - ring;
+	it->c = col - ring;
+}
+
+/**
+ * returns the next cell of the ring inside the grid, -1 at the end
+ * */
+static inline int grid_ring_next(const struct grid* grid, struct grid_ring* it)
+{
+	while (it->r <= it->row + it->ring) {
+		int r = it->r, c = it->c;
+		if (r < 0 || r >= grid->rows) {
+			it->r++;
+			continue;
+		}
+		// only the border of the square of side 2 ring + 1
+		int step = r == it->row - it->ring || r == it->row + it->ring ? 1 : 2 * it->ring;
+		it->c += step > 0 ? step : 1;
+		if (it->c > it->col + it->ring) {
+			it->r++;
+			it->c = it->col - it->ring;
+		}
+		if (c >= 0 && c < grid->cols)
+			return r * grid->cols + c;
+	}
+	return -1;
+}
+
+#endif // GRID_H_
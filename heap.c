@@ -0,0 +1,116 @@
+#include "heap.h"
+#include <stdlib.h>
+
+int heap_init(struct heap* heap, int capacity)
+{
+	heap->capacity = capacity;
+	heap->size = 0;
+	heap->nodes = malloc(sizeof(int) * capacity);
+	heap->position = malloc(sizeof(int) * capacity);
+	heap->keys = malloc(sizeof(double) * capacity);
+	if (!heap->nodes || !heap->position || !heap->keys) {
+		heap_free(heap);
+		return -1;
+	}
+
+	for (int i = 0; i < capacity; i++)
+		heap->position[i] = -1;
+
+	return 0;
+}
+
+void heap_free(struct heap* heap)
+{
+	free(heap->nodes);
+	free(heap->position);
+	free(heap->keys);
+	heap->nodes = NULL;
+	heap->position = NULL;
+	heap->keys = NULL;
+	heap->size = 0;
+}
+
+int heap_empty(const struct heap* heap)
+{
+	return heap->size == 0;
+}
+
+int heap_contains(const struct heap* heap, int node)
+{
+	return heap->position[node] != -1;
+}
+
+double heap_key(const struct heap* heap, int node)
+{
+	return heap->keys[node];
+}
+
+static void heap_place(struct heap* heap, int slot, int node)
+{
+	heap->nodes[slot] = node;
+	heap->position[node] = slot;
+}
+
+static void heap_siftup(struct heap* heap, int slot)
+{
+	int node = heap->nodes[slot];
+	double key = heap->keys[node];
+	while (slot > 0) {
+		int parent = (slot - 1) / 2;
+		if (heap->keys[heap->nodes[parent]] <= key)
+			break;
+		heap_place(heap, slot, heap->nodes[parent]);
+		slot = parent;
+	}
+	heap_place(heap, slot, node);
+}
+
+static void heap_siftdown(struct heap* heap, int slot)
+{
+	int node = heap->nodes[slot];
+	double key = heap->keys[node];
+	while (1) {
+		int child = 2 * slot + 1;
+		if (child >= heap->size)
+			break;
+		if (child + 1 < heap->size && heap->keys[heap->nodes[child + 1]] < heap->keys[heap->nodes[child]])
+			child++;
+		if (key <= heap->keys[heap->nodes[child]])
+			break;
+		heap_place(heap, slot, heap->nodes[child]);
+		slot = child;
+	}
+	heap_place(heap, slot, node);
+}
+
+void heap_push(struct heap* heap, int node, double key)
+{
+	if (heap->position[node] == -1) {
+		heap->keys[node] = key;
+		heap_place(heap, heap->size++, node);
+		heap_siftup(heap, heap->size - 1);
+		return;
+	}
+
+	double old = heap->keys[node];
+	heap->keys[node] = key;
+	if (key < old)
+		heap_siftup(heap, heap->position[node]);
+	else
+		heap_siftdown(heap, heap->position[node]);
+}
+
+int heap_pop(struct heap* heap)
+{
+	if (heap->size == 0)
+		return -1;
+
+	int top = heap->nodes[0];
+	heap->position[top] = -1;
+	heap->size--;
+	if (heap->size > 0) {
+		heap_place(heap, 0, heap->nodes[heap->size]);
+		heap_siftdown(heap, 0);
+	}
+	return top;
+}
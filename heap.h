@@ -0,0 +1,35 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+
+/**
+ * Indexed binary min-heap over the nodes [0, capacity).
+ *
+ * Every node is in the heap at most once. The position array allows to
+ * change the key of a node in O(log n) without searching it.
+ * */
+struct heap {
+	int capacity;
+	int size;
+	int* nodes;    // heap slot -> node
+	int* position; // node -> heap slot, -1 if the node is not in the heap
+	double* keys;  // node -> key
+};
+
+int heap_init(struct heap* heap, int capacity);
+void heap_free(struct heap* heap);
+
+int heap_empty(const struct heap* heap);
+int heap_contains(const struct heap* heap, int node);
+double heap_key(const struct heap* heap, int node);
+
+/**
+ * Inserts a node, or changes its key if it is already in the heap
+ * */
+void heap_push(struct heap* heap, int node, double key);
+
+/**
+ * Removes and returns the node with the minimum key
+ * */
+int heap_pop(struct heap* heap);
+
+#endif // HEAP_H_
@@ -1,12 +1,24 @@
 #include "eventlog.h"
 #include "tsp.h"
+#include "tsp_aco.h"
+#include "tsp_annealing.h"
+#include "tsp_beam.h"
+#include "tsp_bnb.h"
+#include "tsp_candidates.h"
 #include "tsp_cplex.h"
 #include "tsp_diving.h"
+#include "tsp_genetic.h"
+#include "tsp_gls.h"
 #include "tsp_greedy.h"
+#include "tsp_heldkarp.h"
+#include "tsp_insertion.h"
 #include "tsp_instance.h"
 #include "tsp_localbranching.h"
+#include "tsp_onetree.h"
+#include "tsp_som.h"
 #include "tsp_tabu.h"
 #include "tsp_vns.h"
+#include "tsp_window.h"
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +28,7 @@ struct experiment_args {
 	int parse_friendly;
 	int do_plot;
 	int runconfiguration;
+	int lower_bound;
 	char* logfile;
 };
 
@@ -32,6 +45,8 @@ struct experiment_args parse_arguments(int argc, char** argv)
 			args.runconfiguration = atoi(argv[++i]);
 		} else if (!strcmp(argv[i], "--logfile")) {
 			args.logfile = argv[++i];
+		} else if (!strcmp(argv[i], "--lowerbound")) {
+			args.lower_bound = 1;
 		}
 	}
 
@@ -78,6 +93,22 @@ int run_experiment(struct tsp* tsp, int config)
 	if (config == 1) {
 		return tsp_solve_multigreedy(tsp, 1); // multigreedy + 2opt
 	}
+	if (config == 52) {
+		return tsp_solve_multistart(tsp, tsp_solve_greedy_dense, 0); // multigreedy, dense SIMD scan
+	}
+	if (config == 53) {
+		return tsp_solve_multistart(tsp, tsp_solve_greedy_dense, 1); // multigreedy, dense SIMD scan + 2opt
+	}
+	if (config == 50) {
+		return tsp_solve_multigreedy_pruned(tsp, 0); // multigreedy with bound pruning
+	}
+	if (config == 51) {
+		return tsp_solve_multigreedy_pruned(tsp, 1); // multigreedy with bound pruning + 2opt
+	}
+	if (config == 65) {
+		multistart_setgpx(1);
+		return tsp_solve_multigreedy(tsp, 1); // multigreedy + 2opt + partition crossover
+	}
 
 	// vns
 	if (config == 200) {
@@ -108,6 +139,28 @@ int run_experiment(struct tsp* tsp, int config)
 		vns_setrange(6, 8);
 		return tsp_solve_vns(tsp);
 	}
+	if (config == 207) {
+		return tsp_solve_vns_adaptive(tsp); // adaptive kick type and strength
+	}
+	if (config == 208) {
+		vns_setacceptworse(0);
+		return tsp_solve_vns_adaptive(tsp);
+	}
+	if (config == 209) {
+		vns_setacceptworse(0);
+		vns_setrange(1, 2);
+		return tsp_solve_vns(tsp);
+	}
+	if (config == 210) {
+		vns_setacceptworse(0);
+		vns_setrange(1, 4);
+		return tsp_solve_vns(tsp);
+	}
+	if (config == 211) {
+		vns_setacceptworse(0);
+		vns_setrange(1, 8);
+		return tsp_solve_vns(tsp);
+	}
 
 	// tabu fixed tenure
 	if (config == 3) {
@@ -173,6 +226,165 @@ int run_experiment(struct tsp* tsp, int config)
 		return tsp_solve_tabu(tsp, tenure_sin);
 	}
 
+	// tabu on edges with candidate lists
+	if (config == 54) {
+		tenure_fixed_setdivisor(5);
+		return tsp_solve_tabu_edges(tsp, tenure_fixed);
+	}
+	if (config == 55) {
+		tenure_fixed_setdivisor(10);
+		return tsp_solve_tabu_edges(tsp, tenure_fixed);
+	}
+	if (config == 56) {
+		tenure_sin_setdivisor(100);
+		tenure_sin_setscale(10);
+		return tsp_solve_tabu_edges(tsp, tenure_sin);
+	}
+	if (config == 57) {
+		return tsp_solve_tabu_reactive(tsp);
+	}
+
+	// parallel tabu walkers with elite pool
+	if (config == 58) {
+		return tsp_solve_tabu_parallel(tsp, NULL);
+	}
+	if (config == 59) {
+		tenure_sin_setdivisor(100);
+		tenure_sin_setscale(10);
+		return tsp_solve_tabu_parallel(tsp, tenure_sin);
+	}
+
+	// simulated annealing, final temperature as fraction of the initial one
+	if (config == 60) {
+		annealing_setcooling(1e-3);
+		return tsp_solve_annealing(tsp);
+	}
+	if (config == 61) {
+		annealing_setcooling(1e-2);
+		return tsp_solve_annealing(tsp);
+	}
+	if (config == 62) {
+		annealing_setcooling(1e-4);
+		return tsp_solve_annealing(tsp);
+	}
+
+	// genetic algorithm with EAX, population size and children per pair
+	if (config == 63) {
+		genetic_setpopulation(30);
+		genetic_setoffspring(10);
+		return tsp_solve_genetic(tsp);
+	}
+	if (config == 64) {
+		genetic_setpopulation(100);
+		genetic_setoffspring(30);
+		return tsp_solve_genetic(tsp);
+	}
+
+	// max-min ant system, ants per iteration and evaporation
+	if (config == 66) {
+		aco_setants(25);
+		aco_setevaporation(0.02);
+		return tsp_solve_aco(tsp);
+	}
+	if (config == 67) {
+		aco_setants(10);
+		aco_setevaporation(0.1);
+		return tsp_solve_aco(tsp);
+	}
+
+	// guided local search, weight of the penalties
+	if (config == 68) {
+		gls_setalpha(0.3);
+		return tsp_solve_gls(tsp);
+	}
+	if (config == 69) {
+		gls_setalpha(0.1);
+		return tsp_solve_gls(tsp);
+	}
+
+	// beam search construction, width and branching
+	if (config == 70) {
+		beam_setwidth(32);
+		beam_setbranching(5);
+		return tsp_solve_singlestart(tsp, tsp_solve_beam);
+	}
+	if (config == 71) {
+		beam_setwidth(128);
+		beam_setbranching(8);
+		return tsp_solve_singlestart(tsp, tsp_solve_beam);
+	}
+	if (config == 72) {
+		beam_setwidth(32);
+		beam_setbranching(5);
+		return tsp_solve_multistart(tsp, tsp_solve_beam, 1);
+	}
+
+	// self-organizing map construction, the single run doesn't need the
+	// cost matrix (see uses_cost_matrix)
+	if (config == 73) {
+		return tsp_solve_singlestart(tsp, tsp_solve_som);
+	}
+	if (config == 74) {
+		return tsp_solve_multistart(tsp, tsp_solve_som, 1);
+	}
+
+	// 2opt/Or-opt alternated with exact window optimization, window size
+	if (config == 75) {
+		return tsp_solve_window(tsp, 8);
+	}
+	if (config == 76) {
+		return tsp_solve_window(tsp, 12);
+	}
+
+	// exact Held-Karp dynamic programming, small instances only
+	if (config == 77) {
+		return tsp_solve_heldkarp(tsp);
+	}
+
+	// branch and bound on 1-tree bounds, without CPLEX
+	if (config == 78) {
+		return tsp_solve_bnb(tsp);
+	}
+
+	// alpha-nearness candidates from the 1-tree instead of the nearest ones
+	if (config == 79) {
+		candidates_settype(CANDIDATES_ALPHA);
+		vns_setacceptworse(0);
+		return tsp_solve_vns_adaptive(tsp);
+	}
+	if (config == 80) {
+		candidates_settype(CANDIDATES_ALPHA);
+		return tsp_solve_tabu_reactive(tsp);
+	}
+
+	// Delaunay candidates: greedy edge construction (+ 2opt/Or-opt) without
+	// the cost matrix (see uses_cost_matrix), adaptive VNS
+	if (config == 81) {
+		candidates_settype(CANDIDATES_DELAUNAY);
+		return tsp_solve_singlestart(tsp, tsp_solve_greedy_edge);
+	}
+	if (config == 82) {
+		candidates_settype(CANDIDATES_DELAUNAY);
+		return tsp_solve_singlestart_localsearch(tsp, tsp_solve_greedy_edge);
+	}
+	if (config == 83) {
+		candidates_settype(CANDIDATES_DELAUNAY);
+		vns_setacceptworse(0);
+		return tsp_solve_vns_adaptive(tsp);
+	}
+
+	// quadrant candidates, for clustered instances: adaptive VNS, greedy
+	// edge + 2opt/Or-opt without the cost matrix
+	if (config == 84) {
+		candidates_settype(CANDIDATES_QUADRANT);
+		vns_setacceptworse(0);
+		return tsp_solve_vns_adaptive(tsp);
+	}
+	if (config == 85) {
+		candidates_settype(CANDIDATES_QUADRANT);
+		return tsp_solve_singlestart_localsearch(tsp, tsp_solve_greedy_edge);
+	}
+
 	// benders
 	if (config == 16) {
 		return tsp_solve_benders(tsp, 1);
@@ -232,6 +444,10 @@ int run_experiment(struct tsp* tsp, int config)
 	if (config == 303) {
 		return tsp_solve_diving(tsp, 0.1);
 	}
+	if (config == 304) {
+		cplex_setwarmstart(tsp_solve_beam);
+		return tsp_solve_diving(tsp, 0.7);
+	}
 
 	// local branching
 	if (config == 31) {
@@ -243,6 +459,10 @@ int run_experiment(struct tsp* tsp, int config)
 	if (config == 321) {
 		return tsp_solve_localbranching(tsp, 5, 5);
 	}
+	if (config == 322) {
+		cplex_setwarmstart(tsp_solve_beam);
+		return tsp_solve_localbranching(tsp, 10, 5);
+	}
 
 	if (config == 33) {
 		return tsp_solve_benders(tsp, 0);
@@ -252,9 +472,61 @@ int run_experiment(struct tsp* tsp, int config)
 		return tsp_solve_benders(tsp, 1);
 	}
 
+	// construction heuristics (single run from node 0)
+	if (config == 40) {
+		return tsp_solve_singlestart(tsp, tsp_solve_greedy);
+	}
+	if (config == 41) {
+		insertion_setusehull(0);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_nearest);
+	}
+	if (config == 42) {
+		insertion_setusehull(0);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_farthest);
+	}
+	if (config == 43) {
+		insertion_setusehull(0);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_cheapest);
+	}
+	if (config == 44) {
+		insertion_setusehull(1);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_nearest);
+	}
+	if (config == 45) {
+		insertion_setusehull(1);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_farthest);
+	}
+	if (config == 46) {
+		insertion_setusehull(1);
+		return tsp_solve_singlestart(tsp, tsp_solve_insertion_cheapest);
+	}
+
+	// multistart insertion + 2opt
+	if (config == 47) {
+		insertion_setusehull(0);
+		return tsp_solve_multistart(tsp, tsp_solve_insertion_nearest, 1);
+	}
+	if (config == 48) {
+		insertion_setusehull(0);
+		return tsp_solve_multistart(tsp, tsp_solve_insertion_farthest, 1);
+	}
+	if (config == 49) {
+		insertion_setusehull(0);
+		return tsp_solve_multistart(tsp, tsp_solve_insertion_cheapest, 1);
+	}
+
 	return -1;
 }
 
+/**
+ * The configurations reading only the coordinates, they can run on
+ * instances too large for the cost matrix
+ * */
+int uses_cost_matrix(int config)
+{
+	return config != 73 && config != 81 && config != 82 && config != 85;
+}
+
 void print_parse_friendly_output(struct tsp* tsp)
 {
 	double elapsedseconds = tsp_getelapsedseconds(tsp);
@@ -334,12 +606,23 @@ int main(int argc, char** argv)
 	}
 
 	/* tsp_compute_costs(&tsp, tsp_costfunction_euclidian); */
-	tsp_compute_costs(&tsp, tsp_costfunction_att);
+	if (uses_cost_matrix(args.runconfiguration))
+		tsp_compute_costs(&tsp, tsp_costfunction_att);
+	else
+		tsp.costfunction = tsp_costfunction_att;
+
+	// the 1-tree bound runs next to the solver, that logs its gap from it
+	struct lowerbound_thread lower_bound;
+	if (args.lower_bound && lowerbound_start(&tsp, &lower_bound))
+		args.lower_bound = 0;
 
 	if (run_experiment(&tsp, args.runconfiguration)) {
 		fprintf(stderr, "Unable to find a solution\n");
 	}
 
+	if (args.lower_bound && lowerbound_join(&lower_bound))
+		fprintf(stderr, "Unable to compute the lower bound\n");
+
 	conclude_experiment(&tsp, args.parse_friendly, args.do_plot);
 
 	eventlog_close();
@@ -98,3 +98,14 @@ python ../tools/newexperiment.py \
 #         --parallel 8 \
 #         --costortime cost \
 #         "[1,4,10,203]"
+
+#construction_40-41-42-43-44-45-46
+# python ../tools/newexperiment.py \
+#         --output construction.txt \
+#         --executable ../main \
+#         --timelimit 120 \
+#         --ninstances 20 \
+#         --nnodes 1500 \
+#         --parallel 8 \
+#         --costortime cost \
+#         "[40,41,42,43,44,45,46]"
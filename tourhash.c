@@ -0,0 +1,118 @@
+#include "tourhash.h"
+#include <stdlib.h>
+
+// splitmix64 finalizer
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t tourhash_edge(int a, int b)
+{
+	if (a > b) {
+		int temp = a;
+		a = b;
+		b = temp;
+	}
+	return mix64(((uint64_t)a << 32) | (uint32_t)b);
+}
+
+uint64_t tourhash_compute(const int* solution, int nnodes)
+{
+	uint64_t hash = 0;
+	for (int i = 0; i < nnodes - 1; i++)
+		hash += tourhash_edge(solution[i], solution[i + 1]);
+	hash += tourhash_edge(solution[nnodes - 1], solution[0]);
+	return hash;
+}
+
+uint64_t tourhash_2opt_delta(const int* solution, int nnodes, int i, int j)
+{
+	int a = solution[i];
+	int b = solution[i + 1];
+	int c = solution[j];
+	int d = solution[(j + 1) % nnodes];
+	return tourhash_edge(a, c) + tourhash_edge(b, d) - tourhash_edge(a, b) - tourhash_edge(c, d);
+}
+
+int hashset_init(struct hashset* set, int capacity)
+{
+	int c = 16;
+	while (c < capacity)
+		c *= 2;
+	set->capacity = c;
+	set->size = 0;
+	set->slots = calloc(c, sizeof(uint64_t));
+	return set->slots == NULL ? -1 : 0;
+}
+
+void hashset_free(struct hashset* set)
+{
+	free(set->slots);
+	set->slots = NULL;
+	set->size = 0;
+}
+
+// 0 marks an empty slot
+static uint64_t hashset_key(uint64_t hash)
+{
+	return hash == 0 ? 1 : hash;
+}
+
+static int hashset_find(const struct hashset* set, uint64_t key)
+{
+	int mask = set->capacity - 1;
+	int slot = (int)(mix64(key) & mask);
+	while (set->slots[slot] != 0 && set->slots[slot] != key)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+/**
+ * returns -1 if the larger table can't be allocated, the set is unchanged
+ * */
+static int hashset_grow(struct hashset* set)
+{
+	uint64_t* old = set->slots;
+	int old_capacity = set->capacity;
+	uint64_t* slots = calloc(2 * old_capacity, sizeof(uint64_t));
+	if (!slots)
+		return -1;
+
+	set->capacity *= 2;
+	set->slots = slots;
+	for (int i = 0; i < old_capacity; i++) {
+		if (old[i] != 0)
+			set->slots[hashset_find(set, old[i])] = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+int hashset_insert(struct hashset* set, uint64_t hash)
+{
+	uint64_t key = hashset_key(hash);
+	int slot = hashset_find(set, key);
+	if (set->slots[slot] == key)
+		return 0;
+
+	if ((set->size + 1) * 2 > set->capacity) {
+		if (hashset_grow(set))
+			return -1;
+		slot = hashset_find(set, key);
+	}
+	set->slots[slot] = key;
+	set->size++;
+	return 1;
+}
+
+int hashset_contains(const struct hashset* set, uint64_t hash)
+{
+	uint64_t key = hashset_key(hash);
+	return set->slots[hashset_find(set, key)] == key;
+}
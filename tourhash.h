@@ -0,0 +1,46 @@
+#ifndef TOURHASH_H_
+#define TOURHASH_H_
+
+#include <stdint.h>
+
+/**
+ * Hash of an undirected edge.
+ *
+ * The hash of a tour is the sum of the hashes of its edges, so it doesn't
+ * depend on the starting node or on the direction of the tour, and it can
+ * be updated in O(1) when a move replaces some edges.
+ * */
+uint64_t tourhash_edge(int a, int b);
+
+/**
+ * Hash of a tour in the "permutation" format
+ * */
+uint64_t tourhash_compute(const int* solution, int nnodes);
+
+/**
+ * Change of the hash of a tour in the "permutation" format when the
+ * 2opt swap on (i, j) is applied. To be computed before the swap.
+ * */
+uint64_t tourhash_2opt_delta(const int* solution, int nnodes, int i, int j);
+
+/**
+ * Open addressing set of hashes
+ * */
+struct hashset {
+	uint64_t* slots;
+	int capacity; // always a power of 2
+	int size;
+};
+
+int hashset_init(struct hashset* set, int capacity);
+void hashset_free(struct hashset* set);
+
+/**
+ * returns 1 if the hash was not in the set, 0 otherwise, -1 if the set
+ * can't grow (the hash is then not inserted)
+ * */
+int hashset_insert(struct hashset* set, uint64_t hash);
+
+int hashset_contains(const struct hashset* set, uint64_t hash);
+
+#endif // TOURHASH_H_
@@ -1,10 +1,12 @@
 #include "tsp.h"
 #include "chrono.h"
+#include "eventlog.h"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 void tsp_free(struct tsp* tsp)
 {
@@ -19,6 +21,8 @@ void tsp_free(struct tsp* tsp)
 
 	if (tsp->solution_permutation)
 		free(tsp->solution_permutation);
+
+	pthread_mutex_destroy(&tsp->incumbent_lock);
 }
 
 void tsp_init(struct tsp* tsp)
@@ -30,6 +34,8 @@ void tsp_init(struct tsp* tsp)
 	tsp->edge_weight_type = NULL;
 	tsp->nnodes = 0;
 	tsp->force_stop = 0;
+	tsp->nthreads = 1;
+	pthread_mutex_init(&tsp->incumbent_lock, NULL);
 }
 
 int tsp_allocate_buffers(struct tsp* tsp)
@@ -71,6 +77,10 @@ int tsp_parse_arguments(int argc, char** argv, struct tsp* tsp)
 			userSetNnodes = 1;
 		} else if (!strcmp(argv[i], "--timelimit") || !strcmp(argv[i], "-t")) {
 			tsp->timelimit_secs = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--gap")) {
+			tsp->stop_gap = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--threads") || !strcmp(argv[i], "-j")) {
+			tsp->nthreads = atoi(argv[++i]);
 		} else if (!strcmp(argv[i], "--inputfile") || !strcmp(argv[i], "-i")) {
 			tsp->input_file = argv[++i];
 			if (modelSource != -1) {
@@ -172,6 +182,8 @@ int nint(double x)
 
 int tsp_compute_costs(struct tsp* tsp, tsp_costfunction costfunction)
 {
+	tsp->costfunction = costfunction;
+
 	if (tsp->cost_matrix == NULL)
 		tsp_allocate_costs(tsp);
 
@@ -225,9 +237,9 @@ double tsp_recompute_solution_arg(const struct tsp* tsp, int* solution)
 
 	double current_solution = 0;
 	for (int i = 0; i < tsp->nnodes - 1; i++) {
-		current_solution += tsp->cost_matrix[flatten_coords(solution[i], solution[i + 1], tsp->nnodes)];
+		current_solution += tsp_cost(tsp, solution[i], solution[i + 1]);
 	}
-	current_solution += tsp->cost_matrix[flatten_coords(solution[0], solution[tsp->nnodes - 1], tsp->nnodes)];
+	current_solution += tsp_cost(tsp, solution[0], solution[tsp->nnodes - 1]);
 
 	return current_solution;
 }
@@ -265,6 +277,65 @@ void tsp_save_solution(struct tsp* tsp, int* solution, double value)
 	tsp->solution_value = value;
 }
 
+int tsp_save_solution_shared(struct tsp* tsp, const int* solution, double value, int timeinstant)
+{
+	// cheap check without the lock, most of the solutions are worse
+	if (value >= tsp_get_solution_value(tsp))
+		return 0;
+
+	int res = 0;
+	pthread_mutex_lock(&tsp->incumbent_lock);
+	if (value < tsp->solution_value) {
+		memcpy(tsp->solution_permutation, solution, sizeof(int) * tsp->nnodes);
+		__atomic_store(&tsp->solution_value, &value, __ATOMIC_RELEASE);
+		tsp_log_incumbent(tsp, timeinstant, value);
+		res = 1;
+	}
+	pthread_mutex_unlock(&tsp->incumbent_lock);
+	return res;
+}
+
+double tsp_get_solution_value(struct tsp* tsp)
+{
+	double value;
+	__atomic_load(&tsp->solution_value, &value, __ATOMIC_ACQUIRE);
+	return value;
+}
+
+void tsp_log_incumbent(struct tsp* tsp, int timeinstant, double value)
+{
+	eventlog_logdouble("new_incumbent", timeinstant, value);
+	double lower_bound = tsp_get_lower_bound(tsp);
+	if (lower_bound > 0 && value > 0)
+		eventlog_logdouble("gap", timeinstant, (value - lower_bound) / value);
+}
+
+void tsp_save_lower_bound(struct tsp* tsp, double value, int timeinstant)
+{
+	pthread_mutex_lock(&tsp->incumbent_lock);
+	if (value > tsp->lower_bound) {
+		__atomic_store(&tsp->lower_bound, &value, __ATOMIC_RELEASE);
+		eventlog_logdouble("lower_bound", timeinstant, value);
+	}
+	pthread_mutex_unlock(&tsp->incumbent_lock);
+}
+
+double tsp_get_lower_bound(struct tsp* tsp)
+{
+	double value;
+	__atomic_load(&tsp->lower_bound, &value, __ATOMIC_ACQUIRE);
+	return value;
+}
+
+int tsp_getnthreads(const struct tsp* tsp)
+{
+	if (tsp->nthreads > 0)
+		return tsp->nthreads;
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
 int tsp_is_solution_arg(int* solution, int nnodes)
 {
 	if (solution == NULL)
@@ -320,6 +391,32 @@ void tsp_2opt_swap(int left, int right, int* solution)
 	}
 }
 
+void tsp_2opt_swap_pos(int i, int j, int* solution, int* position, int nnodes)
+{
+	int inner = j - i;
+	int left, right, len;
+	if (2 * inner <= nnodes) {
+		left = i + 1;
+		right = j;
+		len = inner;
+	} else {
+		// the complementary segment j + 1 ... i (cyclic) is shorter
+		left = (j + 1) % nnodes;
+		right = i;
+		len = nnodes - inner;
+	}
+
+	for (int k = 0; k < len / 2; k++) {
+		int temp = solution[left];
+		solution[left] = solution[right];
+		solution[right] = temp;
+		position[solution[left]] = left;
+		position[solution[right]] = right;
+		left = left + 1 == nnodes ? 0 : left + 1;
+		right = right == 0 ? nnodes - 1 : right - 1;
+	}
+}
+
 double tsp_costfunction_att(double xi, double xj, double yi, double yj)
 {
 	double deltax = (xi - xj);
@@ -357,6 +454,13 @@ int tsp_shouldstop(struct tsp* tsp)
 {
 	if (tsp->force_stop)
 		return 1;
+	if (tsp->stop_gap > 0) {
+		// the value is 0 until the first solution is saved
+		double lower_bound = tsp_get_lower_bound(tsp);
+		double value = tsp_get_solution_value(tsp);
+		if (lower_bound > 0 && value > 0 && value - lower_bound <= tsp->stop_gap * value)
+			return 1;
+	}
 	if (tsp->timelimit_secs <= 0)
 		return 0;
 
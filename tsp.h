@@ -1,6 +1,8 @@
 #ifndef TSP_H_
 #define TSP_H_
 
+#include <pthread.h>
+
 #define RANDOM_MAX_X            10000
 #define RANDOM_MAX_Y            10000
 #define EPSILON                 1e-7
@@ -17,6 +19,8 @@ struct point {
 	double y;
 };
 
+typedef double (*tsp_costfunction)(double xi, double xj, double yi, double yj);
+
 struct tsp {
 	// instance data
 	int nnodes;
@@ -33,20 +37,30 @@ struct tsp {
 	char* edge_weight_type;
 
 	double* cost_matrix;
+	// used by tsp_cost when the cost matrix is not computed
+	tsp_costfunction costfunction;
 
 	int* solution_permutation;
 	double solution_value;
+	// best known lower bound on the optimum, 0 if unknown
+	double lower_bound;
 
 	// execution control data
 
 	double start_time;
 	double timelimit_secs;
 	int force_stop;
+	// stop when the gap between the incumbent and the lower bound is at
+	// most stop_gap times the incumbent, 0 to disable
+	double stop_gap;
+
+	int nthreads; // 0 means one thread per core
+
+	// protects the solution when it is shared by many threads
+	pthread_mutex_t incumbent_lock;
 };
 
 // COST FUNCTIONS
-typedef double (*tsp_costfunction)(double xi, double xj, double yi, double yj);
-
 int nint(double x);
 
 double tsp_costfunction_att(double xi, double xj, double yi, double yj);
@@ -82,6 +96,17 @@ int tsp_allocate_costs(struct tsp* tsp);
  * */
 int tsp_compute_costs(struct tsp* tsp, tsp_costfunction costfunction);
 
+/**
+ * Cost of the edge (i, j), from the cost matrix if it has been computed,
+ * from the coordinates otherwise
+ * */
+static inline double tsp_cost(const struct tsp* tsp, int i, int j)
+{
+	if (tsp->cost_matrix)
+		return tsp->cost_matrix[flatten_coords(i, j, tsp->nnodes)];
+	return tsp->costfunction(tsp->coords[i].x, tsp->coords[j].x, tsp->coords[i].y, tsp->coords[j].y);
+}
+
 /**
  * Free memory allocated by a tsp struct
  * */
@@ -127,6 +152,14 @@ double tsp_2opt_findbestswap(const struct tsp* tsp, int* solution, int* best_i,
  * */
 void tsp_2opt_swap(int left, int right, int* solution);
 
+/**
+ * Execute the 2opt move removing the edges (solution[i], solution[i + 1])
+ * and (solution[j], solution[j + 1]) with i < j, reversing the shorter of
+ * the two segments of the cycle. position[node] is the index of node in
+ * solution and it is kept updated.
+ * */
+void tsp_2opt_swap_pos(int i, int j, int* solution, int* position, int nnodes);
+
 /**
  * Compute the cost of a solution passed as argument
  * */
@@ -164,11 +197,48 @@ int tsp_is_solution(struct tsp* tsp);
  * */
 void tsp_save_solution(struct tsp* tsp, int* solution, double value);
 
+/**
+ * Thread safe version of tsp_save_solution: saves the solution only if it
+ * is better than the incumbent, and logs it as new_incumbent at the given
+ * time instant while holding the lock, so the logged values are monotone.
+ *
+ * returns 1 if the solution has been saved
+ * */
+int tsp_save_solution_shared(struct tsp* tsp, const int* solution, double value, int timeinstant);
+
+/**
+ * Value of the incumbent, safe to call while other threads update it
+ * */
+double tsp_get_solution_value(struct tsp* tsp);
+
+/**
+ * Log value as new_incumbent and, if a lower bound is known, the relative
+ * gap from it as gap
+ * */
+void tsp_log_incumbent(struct tsp* tsp, int timeinstant, double value);
+
+/**
+ * Save a lower bound if it is better than the known one, safe to call
+ * while other threads read it
+ * */
+void tsp_save_lower_bound(struct tsp* tsp, double value, int timeinstant);
+
+/**
+ * Best known lower bound, 0 if unknown
+ * */
+double tsp_get_lower_bound(struct tsp* tsp);
+
+/**
+ * Number of threads to be used by the parallel solvers
+ * */
+int tsp_getnthreads(const struct tsp* tsp);
+
 /**
  * Returns 1 if the execution should stop, 0 otherwise.
  *
- * The execution could be stopped because the timelimit has been reached or
- * because the user stopped it.
+ * The execution could be stopped because the timelimit has been reached,
+ * because the user stopped it or because the incumbent is within stop_gap
+ * of the lower bound.
  * */
 int tsp_shouldstop(struct tsp* tsp);
 
@@ -0,0 +1,421 @@
+#include "tsp_aco.h"
+#include "eventlog.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include "util.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define ACO_CANDIDATES 10
+#define ACO_BETA       2
+// probability of building the best tour once the pheromone has converged,
+// used to compute the lower bound of the pheromone
+#define ACO_PBEST 0.05
+// every this many iterations the best so far tour deposits pheromone
+#define ACO_GLOBAL_BEST_INTERVAL 5
+
+int ants = 25;
+double evaporation = 0.02;
+
+void aco_setants(int count)
+{
+	ants = count;
+}
+
+void aco_setevaporation(double rho)
+{
+	evaporation = rho;
+}
+
+/**
+ * Pheromone of the candidate edges, in the same layout of the candidate
+ * lists: entry k is the edge (i, cand->nodes[k]) for k in
+ * [offset[i], offset[i + 1])
+ * */
+struct pheromone {
+	int size;
+	double* tau;
+	double* deposit;  // pheromone added by the next update
+	double* eta_beta; // (1 / cost) ^ beta
+	double* weight;	  // tau * eta_beta, read by the ants
+	double tau_min;
+	double tau_max;
+};
+
+static int pheromone_init(struct pheromone* ph, const struct tsp* tsp, const struct candidates* cand)
+{
+	int size = cand->offset[cand->nnodes];
+	ph->size = size;
+	ph->tau = malloc(sizeof(double) * size);
+	ph->deposit = calloc(size, sizeof(double));
+	ph->eta_beta = malloc(sizeof(double) * size);
+	ph->weight = malloc(sizeof(double) * size);
+	if (!ph->tau || !ph->deposit || !ph->eta_beta || !ph->weight)
+		return -1;
+	for (int i = 0; i < cand->nnodes; i++) {
+		for (int k = cand->offset[i]; k < cand->offset[i + 1]; k++) {
+			double cost = tsp->cost_matrix[flatten_coords(i, cand->nodes[k], tsp->nnodes)];
+			ph->eta_beta[k] = pow(1.0 / (cost + EPSILON), ACO_BETA);
+		}
+	}
+	return 0;
+}
+
+static void pheromone_free(struct pheromone* ph)
+{
+	free(ph->tau);
+	free(ph->deposit);
+	free(ph->eta_beta);
+	free(ph->weight);
+}
+
+/**
+ * MMAS bounds for a best tour of the given length
+ * */
+static void pheromone_setbounds(struct pheromone* ph, double best_value, int nnodes, int k)
+{
+	ph->tau_max = 1.0 / (evaporation * best_value);
+	double root = pow(ACO_PBEST, 1.0 / nnodes);
+	double average_choices = k / 2.0 > 1 ? k / 2.0 : 2;
+	ph->tau_min = ph->tau_max * (1 - root) / ((average_choices - 1) * root);
+	if (ph->tau_min > ph->tau_max)
+		ph->tau_min = ph->tau_max;
+}
+
+/**
+ * tau = clamp(tau * (1 - rho) + deposit) and weight = tau * eta_beta on
+ * the whole table
+ * */
+static void pheromone_update(struct pheromone* ph)
+{
+	double persistence = 1 - evaporation;
+	int k = 0;
+#if defined(__AVX2__)
+	__m256d p = _mm256_set1_pd(persistence);
+	__m256d lo = _mm256_set1_pd(ph->tau_min);
+	__m256d hi = _mm256_set1_pd(ph->tau_max);
+	for (; k + 4 <= ph->size; k += 4) {
+		__m256d t = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(ph->tau + k), p),
+					  _mm256_loadu_pd(ph->deposit + k));
+		t = _mm256_min_pd(_mm256_max_pd(t, lo), hi);
+		_mm256_storeu_pd(ph->tau + k, t);
+		_mm256_storeu_pd(ph->weight + k, _mm256_mul_pd(t, _mm256_loadu_pd(ph->eta_beta + k)));
+	}
+#elif defined(__SSE2__)
+	__m128d p = _mm_set1_pd(persistence);
+	__m128d lo = _mm_set1_pd(ph->tau_min);
+	__m128d hi = _mm_set1_pd(ph->tau_max);
+	for (; k + 2 <= ph->size; k += 2) {
+		__m128d t = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(ph->tau + k), p), _mm_loadu_pd(ph->deposit + k));
+		t = _mm_min_pd(_mm_max_pd(t, lo), hi);
+		_mm_storeu_pd(ph->tau + k, t);
+		_mm_storeu_pd(ph->weight + k, _mm_mul_pd(t, _mm_loadu_pd(ph->eta_beta + k)));
+	}
+#endif
+	for (; k < ph->size; k++) {
+		double t = ph->tau[k] * persistence + ph->deposit[k];
+		t = t < ph->tau_min ? ph->tau_min : (t > ph->tau_max ? ph->tau_max : t);
+		ph->tau[k] = t;
+		ph->weight[k] = t * ph->eta_beta[k];
+	}
+}
+
+static int candidate_index(const struct candidates* cand, int i, int j)
+{
+	for (int k = cand->offset[i]; k < cand->offset[i + 1]; k++) {
+		if (cand->nodes[k] == j)
+			return k;
+	}
+	return -1;
+}
+
+/**
+ * Sets (amount != 0) or clears (amount = 0) the deposit on the candidate
+ * edges of the tour
+ * */
+static void pheromone_setdeposit(struct pheromone* ph, const struct candidates* cand, const int* tour, int n,
+				 double amount)
+{
+	for (int i = 0; i < n; i++) {
+		int u = tour[i], v = tour[i + 1 == n ? 0 : i + 1];
+		int k = candidate_index(cand, u, v);
+		if (k >= 0)
+			ph->deposit[k] = amount;
+		k = candidate_index(cand, v, u);
+		if (k >= 0)
+			ph->deposit[k] = amount;
+	}
+}
+
+/**
+ * Buffers of the ants built by a thread
+ * */
+struct ant_workspace {
+	int* position;
+	char* visited;
+	int* unvisited; // unvisited nodes, in any order
+	int* where;	// index of each node in unvisited
+	double* weights;
+	struct local_search ls;
+	struct rng rng;
+};
+
+static int ant_workspace_init(struct ant_workspace* ws, const struct candidates* cand, int n, uint64_t seed)
+{
+	memset(ws, 0, sizeof(struct ant_workspace));
+	ws->position = malloc(sizeof(int) * n);
+	ws->visited = malloc(sizeof(char) * n);
+	ws->unvisited = malloc(sizeof(int) * n);
+	ws->where = malloc(sizeof(int) * n);
+	ws->weights = malloc(sizeof(double) * (cand->offset[n] > 0 ? cand->offset[n] : 1));
+	rng_seed(&ws->rng, seed);
+	if (!ws->position || !ws->visited || !ws->unvisited || !ws->where || !ws->weights ||
+	    local_search_init(&ws->ls, cand))
+		return -1;
+	ws->ls.oropt = 1;
+	return 0;
+}
+
+static void ant_workspace_free(struct ant_workspace* ws)
+{
+	free(ws->position);
+	free(ws->visited);
+	free(ws->unvisited);
+	free(ws->where);
+	free(ws->weights);
+	local_search_free(&ws->ls);
+}
+
+struct aco_context {
+	struct tsp* tsp;
+	const struct candidates* cand;
+	const struct pheromone* ph;
+	int* tours; // ants x nnodes
+	double* values;
+	atomic_int next_ant;
+};
+
+struct aco_worker {
+	struct aco_context* ctx;
+	struct ant_workspace* ws;
+};
+
+static void visit(struct ant_workspace* ws, int node, int* nunvisited)
+{
+	ws->visited[node] = 1;
+	int last = ws->unvisited[--(*nunvisited)];
+	ws->unvisited[ws->where[node]] = last;
+	ws->where[last] = ws->where[node];
+}
+
+static void build_ant(struct aco_context* ctx, struct ant_workspace* ws, int ant)
+{
+	struct tsp* tsp = ctx->tsp;
+	const struct candidates* cand = ctx->cand;
+	const double* weight = ctx->ph->weight;
+	int n = tsp->nnodes;
+	int* tour = ctx->tours + (size_t)ant * n;
+
+	memset(ws->visited, 0, n);
+	for (int i = 0; i < n; i++) {
+		ws->unvisited[i] = i;
+		ws->where[i] = i;
+	}
+	int nunvisited = n;
+	int current = rng_randint(&ws->rng, n);
+	visit(ws, current, &nunvisited);
+	tour[0] = current;
+	double value = 0;
+
+	for (int step = 1; step < n; step++) {
+		double total = 0;
+		for (int k = cand->offset[current]; k < cand->offset[current + 1]; k++) {
+			double w = ws->visited[cand->nodes[k]] ? 0 : weight[k];
+			ws->weights[k] = w;
+			total += w;
+		}
+
+		int next = -1;
+		if (total > 0) {
+			double r = rng_random01(&ws->rng) * total;
+			for (int k = cand->offset[current]; k < cand->offset[current + 1]; k++) {
+				r -= ws->weights[k];
+				if (ws->weights[k] > 0) {
+					next = cand->nodes[k];
+					if (r <= 0)
+						break;
+				}
+			}
+		} else {
+			// every candidate is visited: nearest unvisited node
+			const double* row = tsp->cost_matrix + (size_t)current * n;
+			double best = INFINITY;
+			for (int i = 0; i < nunvisited; i++) {
+				if (row[ws->unvisited[i]] < best) {
+					best = row[ws->unvisited[i]];
+					next = ws->unvisited[i];
+				}
+			}
+		}
+
+		value += tsp->cost_matrix[flatten_coords(current, next, n)];
+		visit(ws, next, &nunvisited);
+		tour[step] = next;
+		current = next;
+	}
+	value += tsp->cost_matrix[flatten_coords(current, tour[0], n)];
+
+	for (int i = 0; i < n; i++)
+		ws->position[tour[i]] = i;
+	local_search_push_all(&ws->ls);
+	local_search_2opt(tsp, &ws->ls, tour, ws->position, &value);
+	ctx->values[ant] = value;
+}
+
+static void* aco_worker(void* arg)
+{
+	struct aco_worker* worker = arg;
+	struct aco_context* ctx = worker->ctx;
+	int ant;
+	while ((ant = atomic_fetch_add(&ctx->next_ant, 1)) < ants) {
+		if (tsp_shouldstop(ctx->tsp)) {
+			ctx->values[ant] = INFINITY;
+			continue;
+		}
+		build_ant(ctx, worker->ws, ant);
+	}
+	return NULL;
+}
+
+int tsp_solve_aco(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 8 || ants < 1)
+		return -1;
+
+	int n = tsp->nnodes;
+	int res = 0;
+	int nthreads = tsp_getnthreads(tsp);
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+
+	struct candidates cand = {0};
+	struct pheromone ph = {0};
+	struct ant_workspace* workspaces = calloc(nthreads, sizeof(struct ant_workspace));
+	struct aco_worker* workers = malloc(sizeof(struct aco_worker) * nthreads);
+	pthread_t* threads = malloc(sizeof(pthread_t) * nthreads);
+	int* tours = malloc(sizeof(int) * (size_t)ants * n);
+	double* values = malloc(sizeof(double) * ants);
+	int initialized = 0;
+	if (!workspaces || !workers || !threads || !tours || !values ||
+	    candidates_build(tsp, ACO_CANDIDATES, &cand) || pheromone_init(&ph, tsp, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	struct aco_context ctx = {
+	    .tsp = tsp,
+	    .cand = &cand,
+	    .ph = &ph,
+	    .tours = tours,
+	    .values = values,
+	};
+	for (; initialized < nthreads; initialized++) {
+		if (ant_workspace_init(&workspaces[initialized], &cand, n, rng_next(&rng))) {
+			ant_workspace_free(&workspaces[initialized]);
+			res = -1;
+			goto free_buffers;
+		}
+		workers[initialized].ctx = &ctx;
+		workers[initialized].ws = &workspaces[initialized];
+	}
+
+	tsp_starttimer(tsp);
+
+	// the greedy tour gives the initial pheromone bounds
+	if (tsp_solve_greedy(tsp, rng_randint(&rng, n), tsp->solution_permutation, &tsp->solution_value)) {
+		res = -1;
+		goto free_buffers;
+	}
+	tsp_log_incumbent(tsp, 0, tsp->solution_value);
+	pheromone_setbounds(&ph, tsp->solution_value, n, ACO_CANDIDATES);
+	for (int k = 0; k < ph.size; k++)
+		ph.tau[k] = ph.tau_max;
+	pheromone_update(&ph);
+
+	int iteration = 0;
+	while (!tsp_shouldstop(tsp)) {
+		iteration++;
+		atomic_init(&ctx.next_ant, 0);
+		int started = 0;
+		for (; started < nthreads; started++) {
+			if (pthread_create(&threads[started], NULL, aco_worker, &workers[started])) {
+				fprintf(stderr, "Can't create thread\n");
+				break;
+			}
+		}
+		for (int i = 0; i < started; i++)
+			pthread_join(threads[i], NULL);
+		if (started == 0) {
+			res = -1;
+			goto free_buffers;
+		}
+
+		int best = 0;
+		for (int a = 1; a < ants; a++) {
+			if (values[a] < values[best])
+				best = a;
+		}
+		if (values[best] == INFINITY)
+			break; // stopped before building any ant
+		eventlog_logdouble("new_current", iteration, values[best]);
+		if (values[best] < tsp->solution_value - EPSILON) {
+			tsp_save_solution(tsp, tours + (size_t)best * n, values[best]);
+			tsp_log_incumbent(tsp, iteration, values[best]);
+			pheromone_setbounds(&ph, tsp->solution_value, n, ACO_CANDIDATES);
+		}
+
+		const int* depositing = tours + (size_t)best * n;
+		double depositing_value = values[best];
+		if (iteration % ACO_GLOBAL_BEST_INTERVAL == 0) {
+			depositing = tsp->solution_permutation;
+			depositing_value = tsp->solution_value;
+		}
+		pheromone_setdeposit(&ph, &cand, depositing, n, 1.0 / depositing_value);
+		pheromone_update(&ph);
+		pheromone_setdeposit(&ph, &cand, depositing, n, 0);
+	}
+
+	double elapsed = tsp_getelapsedseconds(tsp);
+	fprintf(stderr, "Iterations: %d, ants: %ld in %lf s (%lf/s) with %d threads\n", iteration,
+		(long)iteration * ants, elapsed, elapsed > 0 ? iteration * ants / elapsed : 0, nthreads);
+
+free_buffers:
+	for (int i = 0; i < initialized; i++)
+		ant_workspace_free(&workspaces[i]);
+	pheromone_free(&ph);
+	candidates_free(&cand);
+	free(values);
+	free(tours);
+	free(threads);
+	free(workers);
+	free(workspaces);
+	return res;
+}
@@ -0,0 +1,28 @@
+#ifndef TSP_ACO_H_
+#define TSP_ACO_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with MAX-MIN ant system.
+ *
+ * The ants only move along the candidate lists (to the nearest unvisited
+ * node when every candidate is visited), so the pheromone is stored only
+ * for the candidate edges. Every ant tour is improved with 2opt/Or-opt,
+ * then the best ant of the iteration (periodically the best so far)
+ * deposits pheromone. The ants of an iteration are built by
+ * tsp_getnthreads() threads.
+ * */
+int tsp_solve_aco(struct tsp* tsp);
+
+/**
+ * Set the number of ants of each iteration
+ * */
+void aco_setants(int ants);
+
+/**
+ * Set the fraction of pheromone evaporating at each iteration
+ * */
+void aco_setevaporation(double rho);
+
+#endif // TSP_ACO_H_
@@ -0,0 +1,271 @@
+#include "tsp_annealing.h"
+#include "eventlog.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include "util.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ANNEALING_CANDIDATES 10
+// moves sampled and evaluated together, before any of them is applied
+#define ANNEALING_BATCH 16
+// batches between two updates of the temperature
+#define ANNEALING_UPDATE_INTERVAL 1024
+// probability of accepting an average worsening move at the start
+#define ANNEALING_INITIAL_ACCEPTANCE 0.2
+#define ANNEALING_CALIBRATION_MOVES  1000
+// length of the schedule (in moves per node) if there is no time limit
+#define ANNEALING_MOVES_PER_NODE 10000
+
+double final_ratio = 1e-3;
+
+void annealing_setcooling(double ratio)
+{
+	final_ratio = ratio;
+}
+
+#define MOVE_2OPT  0
+#define MOVE_OROPT 1
+
+/**
+ * 2opt: removes (x, succ x), (y, succ y), adds (x, y), (succ x, succ y).
+ *
+ * Or-opt: moves the segment s1 ... s2 (1 to 3 nodes, p before and nx
+ * after it) between u and v, with s1 next to u if forward is set, else
+ * next to v.
+ *
+ * delta is the change of the tour cost.
+ * */
+struct sa_move {
+	int type;
+	int x, y;
+	int s1, s2, p, nx, u, v, forward;
+	double delta;
+};
+
+/**
+ * Samples a move adding an edge between a random node and one of its
+ * candidates. delta is INFINITY if the move is not valid
+ * */
+static void sample_move(const struct tsp* tsp,
+			const struct candidates* cand,
+			const int* solution,
+			const int* position,
+			struct rng* rng,
+			struct sa_move* move)
+{
+	int n = tsp->nnodes;
+	int a = rng_randint(rng, n);
+	int degree = cand->offset[a + 1] - cand->offset[a];
+	int c = cand->nodes[cand->offset[a] + rng_randint(rng, degree)];
+	uint64_t bits = rng_next(rng);
+	move->delta = INFINITY;
+
+	if (bits & 1) {
+		move->type = MOVE_2OPT;
+		if (bits & 2) {
+			move->x = a;
+			move->y = c;
+		} else {
+			move->x = tour_pred(solution, position, n, a);
+			move->y = tour_pred(solution, position, n, c);
+		}
+		int sx = tour_succ(solution, position, n, move->x);
+		int sy = tour_succ(solution, position, n, move->y);
+		if (move->y == sx || move->x == sy)
+			return;
+		move->delta = tsp_cost(tsp, move->x, move->y) + tsp_cost(tsp, sx, sy) - tsp_cost(tsp, move->x, sx) -
+			      tsp_cost(tsp, move->y, sy);
+		return;
+	}
+
+	move->type = MOVE_OROPT;
+	int len = 1 + (bits >> 2) % 3;
+	move->s1 = a;
+	move->s2 = solution[(position[a] + len - 1) % n];
+	move->p = tour_pred(solution, position, n, move->s1);
+	move->nx = tour_succ(solution, position, n, move->s2);
+	// s1 is placed next to its candidate c
+	if (bits & 32) {
+		move->u = c;
+		move->v = tour_succ(solution, position, n, c);
+		move->forward = 1;
+	} else {
+		move->u = tour_pred(solution, position, n, c);
+		move->v = c;
+		move->forward = 0;
+	}
+	if (len == 1)
+		move->forward = 0; // same move, avoids a useless reversal
+
+	int u_offset = (position[move->u] - position[a] + n) % n;
+	int v_offset = (position[move->v] - position[a] + n) % n;
+	if (u_offset < len || v_offset < len || move->u == move->nx || move->v == move->p)
+		return;
+
+	double removed = tsp_cost(tsp, move->p, move->s1) + tsp_cost(tsp, move->s2, move->nx) +
+			 tsp_cost(tsp, move->u, move->v);
+	double added = tsp_cost(tsp, move->p, move->nx);
+	if (move->forward)
+		added += tsp_cost(tsp, move->u, move->s1) + tsp_cost(tsp, move->s2, move->v);
+	else
+		added += tsp_cost(tsp, move->u, move->s2) + tsp_cost(tsp, move->s1, move->v);
+	move->delta = added - removed;
+}
+
+static void apply_move(struct local_search* ls, const struct sa_move* move, int* solution, int* position)
+{
+	if (move->type == MOVE_2OPT) {
+		int i = position[move->x], j = position[move->y];
+		local_search_swap(ls, i < j ? i : j, i < j ? j : i, solution, position);
+		return;
+	}
+	local_search_oropt(ls, move->p, move->s1, move->s2, move->nx, move->u, move->v, move->forward, solution,
+			   position);
+}
+
+/**
+ * Temperature such that an average worsening move of the starting tour is
+ * accepted with probability ANNEALING_INITIAL_ACCEPTANCE
+ * */
+static double initial_temperature(const struct tsp* tsp,
+				  const struct candidates* cand,
+				  const int* solution,
+				  const int* position,
+				  struct rng* rng)
+{
+	double sum = 0;
+	int count = 0;
+	struct sa_move move;
+	for (int i = 0; i < ANNEALING_CALIBRATION_MOVES; i++) {
+		sample_move(tsp, cand, solution, position, rng, &move);
+		if (move.delta > 0 && move.delta < INFINITY) {
+			sum += move.delta;
+			count++;
+		}
+	}
+	if (count == 0)
+		return 1;
+	return (sum / count) / -log(ANNEALING_INITIAL_ACCEPTANCE);
+}
+
+int tsp_solve_annealing(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 8)
+		return -1;
+
+	int n = tsp->nnodes;
+	int res = 0;
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	int* current_solution = malloc(sizeof(int) * n);
+	int* position = malloc(sizeof(int) * n);
+	if (!current_solution || !position || candidates_build(tsp, ANNEALING_CANDIDATES, &cand) ||
+	    local_search_init(&ls, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	// starting solution is solved with a greedy approach
+	double current_solution_value;
+	if (tsp_solve_greedy(tsp, rng_randint(&rng, n), current_solution, &current_solution_value)) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int i = 0; i < n; i++)
+		position[current_solution[i]] = i;
+	tsp_save_solution(tsp, current_solution, current_solution_value);
+	eventlog_logdouble("new_current", 0, current_solution_value);
+	tsp_log_incumbent(tsp, 0, current_solution_value);
+
+	tsp_starttimer(tsp);
+
+	double initial = initial_temperature(tsp, &cand, current_solution, position, &rng);
+	double temperature = initial;
+	// the incumbent is copied only when the search is about to leave it
+	double best_value = current_solution_value;
+	int best_pending = 0;
+	long batches = 0;
+	long accepted = 0;
+	long schedule_batches = (long)ANNEALING_MOVES_PER_NODE * n / ANNEALING_BATCH;
+	struct sa_move moves[ANNEALING_BATCH];
+
+	while (1) {
+		if (batches % ANNEALING_UPDATE_INTERVAL == 0) {
+			if (tsp_shouldstop(tsp))
+				break;
+			double progress;
+			if (tsp->timelimit_secs > 0)
+				progress = tsp_getelapsedseconds(tsp) / tsp->timelimit_secs;
+			else if (batches < schedule_batches)
+				progress = (double)batches / schedule_batches;
+			else
+				break;
+			temperature = initial * pow(final_ratio, progress);
+
+			int instant = batches / ANNEALING_UPDATE_INTERVAL;
+			eventlog_logdouble("temperature", instant, temperature);
+			eventlog_logdouble("new_current", instant, current_solution_value);
+		}
+		batches++;
+
+		// evaluate the whole batch first: the samples are independent,
+		// so their memory accesses overlap
+		for (int k = 0; k < ANNEALING_BATCH; k++)
+			sample_move(tsp, &cand, current_solution, position, &rng, &moves[k]);
+
+		// apply the first accepted move, the others are evaluated on a
+		// tour that doesn't exist anymore
+		for (int k = 0; k < ANNEALING_BATCH; k++) {
+			double delta = moves[k].delta;
+			if (delta == INFINITY)
+				continue;
+			if (delta > 0 && rng_random01(&rng) >= exp(-delta / temperature))
+				continue;
+
+			if (delta > 0 && best_pending) {
+				tsp_save_solution(tsp, current_solution, best_value);
+				tsp_log_incumbent(tsp, batches / ANNEALING_UPDATE_INTERVAL, best_value);
+				best_pending = 0;
+			}
+			apply_move(&ls, &moves[k], current_solution, position);
+			current_solution_value += delta;
+			accepted++;
+			if (current_solution_value < best_value - EPSILON) {
+				best_value = current_solution_value;
+				best_pending = 1;
+			}
+			break;
+		}
+	}
+
+	if (best_pending) {
+		tsp_save_solution(tsp, current_solution, best_value);
+		tsp_log_incumbent(tsp, batches / ANNEALING_UPDATE_INTERVAL, best_value);
+	}
+
+	double elapsed = tsp_getelapsedseconds(tsp);
+	fprintf(stderr, "Moves: %ld evaluated, %ld accepted in %lf s (%lf/s), initial temperature %lf\n",
+		batches * ANNEALING_BATCH, accepted, elapsed, elapsed > 0 ? batches * ANNEALING_BATCH / elapsed : 0,
+		initial);
+
+free_buffers:
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
+	free(current_solution);
+	return res;
+}
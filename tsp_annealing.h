@@ -0,0 +1,21 @@
+#ifndef TSP_ANNEALING_H_
+#define TSP_ANNEALING_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with simulated annealing on 2opt and Or-opt moves
+ * between candidate neighbours.
+ *
+ * The temperature decreases geometrically from a value calibrated on the
+ * starting tour to a small fraction of it, following the elapsed fraction
+ * of the time limit.
+ * */
+int tsp_solve_annealing(struct tsp* tsp);
+
+/**
+ * Set the final temperature as a fraction of the initial one
+ * */
+void annealing_setcooling(double final_ratio);
+
+#endif // TSP_ANNEALING_H_
@@ -0,0 +1,330 @@
+#include "tsp_beam.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// minimum size of the candidate lists, also used by the bound
+#define BEAM_CANDIDATES 8
+
+int beam_width = 32;
+int beam_branching = 5;
+
+void beam_setwidth(int width)
+{
+	beam_width = width;
+}
+
+void beam_setbranching(int branching)
+{
+	beam_branching = branching;
+}
+
+struct beam_state {
+	double cost;
+	double bound; // lower bound on the cost of the unvisited nodes
+	int last;
+};
+
+struct beam_child {
+	double score;
+	double cost;
+	double bound;
+	int parent;
+	int node;
+};
+
+struct beam_context {
+	struct tsp* tsp;
+	const struct candidates* cand;
+	const double* farthest; // cost of the most expensive candidate edge of each node
+	int width;
+	int words; // 64 bit words of each visited set
+	int starting_node;
+
+	// the beam of the current step is in buffer step % 2
+	struct beam_state* states[2];
+	uint64_t* visited[2];
+	int size;
+
+	struct beam_child* children; // width * branching slots, the selected ones first
+	int selected;
+
+	// node and parent of each state at each step, the tours are rebuilt
+	// backwards at the end
+	int* trail_node;
+	int* trail_parent;
+
+	int nthreads;
+	int ready;
+	pthread_mutex_t ready_lock;
+	pthread_cond_t ready_cond;
+	pthread_barrier_t barrier;
+};
+
+static inline int is_visited(const uint64_t* visited, int node)
+{
+	return (visited[node >> 6] >> (node & 63)) & 1;
+}
+
+/**
+ * Half of the two cheapest edges from u to unvisited candidates (other
+ * than skip), the farthest candidate edge standing for the missing ones
+ * */
+static double node_bound(const struct beam_context* ctx, const uint64_t* visited, int u, int skip)
+{
+	const struct candidates* cand = ctx->cand;
+	const double* row = ctx->tsp->cost_matrix + (size_t)u * ctx->tsp->nnodes;
+	double edges[2] = {ctx->farthest[u], ctx->farthest[u]};
+	int found = 0;
+	for (int k = cand->offset[u]; k < cand->offset[u + 1] && found < 2; k++) {
+		int v = cand->nodes[k];
+		if (v != skip && !is_visited(visited, v))
+			edges[found++] = row[v];
+	}
+	return (edges[0] + edges[1]) / 2;
+}
+
+/**
+ * Change of the bound when node is visited: its own share is paid, and
+ * its unvisited candidates lose it as a cheap neighbour
+ * */
+static double bound_delta(const struct beam_context* ctx, const uint64_t* visited, int node)
+{
+	const struct candidates* cand = ctx->cand;
+	double delta = -node_bound(ctx, visited, node, -1);
+	for (int k = cand->offset[node]; k < cand->offset[node + 1]; k++) {
+		int u = cand->nodes[k];
+		if (!is_visited(visited, u))
+			delta += node_bound(ctx, visited, u, node) - node_bound(ctx, visited, u, -1);
+	}
+	return delta;
+}
+
+static void expand(struct beam_context* ctx, int step, int b)
+{
+	const struct tsp* tsp = ctx->tsp;
+	const struct candidates* cand = ctx->cand;
+	int n = tsp->nnodes;
+	const struct beam_state* state = &ctx->states[(step - 1) & 1][b];
+	const uint64_t* visited = ctx->visited[(step - 1) & 1] + (size_t)b * ctx->words;
+	struct beam_child* children = ctx->children + (size_t)b * beam_branching;
+	const double* row = tsp->cost_matrix + (size_t)state->last * n;
+
+	int count = 0;
+	for (int k = cand->offset[state->last]; k < cand->offset[state->last + 1] && count < beam_branching; k++) {
+		int c = cand->nodes[k];
+		if (is_visited(visited, c))
+			continue;
+		children[count].node = c;
+		count++;
+	}
+	if (count == 0) {
+		double best = INFINITY;
+		for (int c = 0; c < n; c++) {
+			if (!is_visited(visited, c) && row[c] < best) {
+				best = row[c];
+				children[0].node = c;
+			}
+		}
+		count = 1;
+	}
+
+	for (int i = 0; i < beam_branching; i++) {
+		struct beam_child* child = &children[i];
+		if (i >= count) {
+			child->score = INFINITY;
+			continue;
+		}
+		child->parent = b;
+		child->cost = state->cost + row[child->node];
+		child->bound = state->bound + bound_delta(ctx, visited, child->node);
+		child->score = child->cost + child->bound;
+		if (step == n - 1)
+			child->score += tsp->cost_matrix[flatten_coords(child->node, ctx->starting_node, n)];
+	}
+}
+
+static int compar_children(const void* a, const void* b)
+{
+	double sa = ((const struct beam_child*)a)->score;
+	double sb = ((const struct beam_child*)b)->score;
+	return (sa > sb) - (sa < sb);
+}
+
+/**
+ * Moves the best children of the step to the front, called by a single
+ * thread
+ * */
+static void select_children(struct beam_context* ctx)
+{
+	int count = 0;
+	for (int i = 0; i < ctx->size * beam_branching; i++) {
+		if (ctx->children[i].score != INFINITY)
+			ctx->children[count++] = ctx->children[i];
+	}
+	qsort(ctx->children, count, sizeof(struct beam_child), compar_children);
+	ctx->selected = count < ctx->width ? count : ctx->width;
+}
+
+static void build(struct beam_context* ctx, int step, int i)
+{
+	const struct beam_child* child = &ctx->children[i];
+	struct beam_state* state = &ctx->states[step & 1][i];
+	uint64_t* visited = ctx->visited[step & 1] + (size_t)i * ctx->words;
+	memcpy(visited, ctx->visited[(step - 1) & 1] + (size_t)child->parent * ctx->words,
+	       sizeof(uint64_t) * ctx->words);
+	visited[child->node >> 6] |= (uint64_t)1 << (child->node & 63);
+	state->cost = child->cost;
+	state->bound = child->bound;
+	state->last = child->node;
+	ctx->trail_node[(size_t)step * ctx->width + i] = child->node;
+	ctx->trail_parent[(size_t)step * ctx->width + i] = child->parent;
+}
+
+struct beam_worker {
+	struct beam_context* ctx;
+	int id;
+};
+
+static void* beam_worker(void* arg)
+{
+	struct beam_worker* worker = arg;
+	struct beam_context* ctx = worker->ctx;
+	int id = worker->id;
+
+	pthread_mutex_lock(&ctx->ready_lock);
+	while (!ctx->ready)
+		pthread_cond_wait(&ctx->ready_cond, &ctx->ready_lock);
+	pthread_mutex_unlock(&ctx->ready_lock);
+
+	for (int step = 1; step < ctx->tsp->nnodes; step++) {
+		for (int b = id; b < ctx->size; b += ctx->nthreads)
+			expand(ctx, step, b);
+		pthread_barrier_wait(&ctx->barrier);
+		if (id == 0) {
+			select_children(ctx);
+			ctx->size = ctx->selected;
+		}
+		pthread_barrier_wait(&ctx->barrier);
+		for (int i = id; i < ctx->size; i += ctx->nthreads)
+			build(ctx, step, i);
+		pthread_barrier_wait(&ctx->barrier);
+	}
+	return NULL;
+}
+
+int tsp_solve_beam(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	if (!tsp->cost_matrix)
+		return -1;
+
+	int n = tsp->nnodes;
+	if (n < 3 || beam_width < 1 || beam_branching < 1)
+		return -1;
+
+	int res = 0;
+	int width = beam_width;
+	int nthreads = tsp_getnthreads(tsp) < width ? tsp_getnthreads(tsp) : width;
+	struct candidates cand = {0};
+	struct beam_context ctx = {
+	    .tsp = tsp,
+	    .cand = &cand,
+	    .width = width,
+	    .words = (n + 63) / 64,
+	    .starting_node = starting_node,
+	};
+	double* farthest = malloc(sizeof(double) * n);
+	ctx.farthest = farthest;
+	for (int i = 0; i < 2; i++) {
+		ctx.states[i] = malloc(sizeof(struct beam_state) * width);
+		ctx.visited[i] = calloc((size_t)width * ctx.words, sizeof(uint64_t));
+	}
+	ctx.children = malloc(sizeof(struct beam_child) * width * beam_branching);
+	ctx.trail_node = malloc(sizeof(int) * (size_t)n * width);
+	ctx.trail_parent = malloc(sizeof(int) * (size_t)n * width);
+	pthread_t* threads = malloc(sizeof(pthread_t) * nthreads);
+	struct beam_worker* workers = malloc(sizeof(struct beam_worker) * nthreads);
+	if (!farthest || !ctx.states[0] || !ctx.states[1] || !ctx.visited[0] || !ctx.visited[1] || !ctx.children ||
+	    !ctx.trail_node || !ctx.trail_parent || !threads || !workers ||
+	    candidates_build(tsp, beam_branching > BEAM_CANDIDATES ? beam_branching : BEAM_CANDIDATES, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	for (int i = 0; i < n; i++) {
+		farthest[i] = 0;
+		for (int k = cand.offset[i]; k < cand.offset[i + 1]; k++) {
+			double cost = tsp->cost_matrix[flatten_coords(i, cand.nodes[k], n)];
+			if (cost > farthest[i])
+				farthest[i] = cost;
+		}
+	}
+
+	// every node is entered and left: half of its two cheapest edges
+	double bound = 0;
+	for (int i = 0; i < n; i++)
+		bound += node_bound(&ctx, ctx.visited[0], i, -1);
+
+	ctx.size = 1;
+	ctx.states[0][0].cost = 0;
+	ctx.states[0][0].bound = bound + bound_delta(&ctx, ctx.visited[0], starting_node);
+	ctx.states[0][0].last = starting_node;
+	ctx.visited[0][starting_node >> 6] |= (uint64_t)1 << (starting_node & 63);
+
+	// the threads wait until the number of started ones is known
+	pthread_mutex_init(&ctx.ready_lock, NULL);
+	pthread_cond_init(&ctx.ready_cond, NULL);
+	int started = 1;
+	for (; started < nthreads; started++) {
+		workers[started].ctx = &ctx;
+		workers[started].id = started;
+		if (pthread_create(&threads[started], NULL, beam_worker, &workers[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	ctx.nthreads = started;
+	pthread_barrier_init(&ctx.barrier, NULL, started);
+	pthread_mutex_lock(&ctx.ready_lock);
+	ctx.ready = 1;
+	pthread_cond_broadcast(&ctx.ready_cond);
+	pthread_mutex_unlock(&ctx.ready_lock);
+
+	workers[0].ctx = &ctx;
+	workers[0].id = 0;
+	beam_worker(&workers[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_barrier_destroy(&ctx.barrier);
+	pthread_cond_destroy(&ctx.ready_cond);
+	pthread_mutex_destroy(&ctx.ready_lock);
+
+	// the states are sorted by score, which includes the closing edge
+	int b = 0;
+	const struct beam_state* last = &ctx.states[(n - 1) & 1][b];
+	*output_value = last->cost + tsp->cost_matrix[flatten_coords(last->last, starting_node, n)];
+	for (int step = n - 1; step > 0; step--) {
+		output_solution[step] = ctx.trail_node[(size_t)step * width + b];
+		b = ctx.trail_parent[(size_t)step * width + b];
+	}
+	output_solution[0] = starting_node;
+
+free_buffers:
+	candidates_free(&cand);
+	free(workers);
+	free(threads);
+	free(ctx.trail_parent);
+	free(ctx.trail_node);
+	free(ctx.children);
+	for (int i = 0; i < 2; i++) {
+		free(ctx.visited[i]);
+		free(ctx.states[i]);
+	}
+	free(farthest);
+	return res;
+}
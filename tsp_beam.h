@@ -0,0 +1,32 @@
+#ifndef TSP_BEAM_H_
+#define TSP_BEAM_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with beam search, with the signature of a
+ * tsp_constructor.
+ *
+ * At each step every partial tour of the beam is extended with its
+ * cheapest unvisited candidates (the nearest unvisited node if there are
+ * none), and the extensions with the lowest cost plus an estimate of the
+ * cost of the remaining nodes form the next beam. The estimate is half of
+ * the two cheapest edges from each unvisited node to its unvisited
+ * candidates, updated only around the visited node. Each step is
+ * expanded in parallel by tsp_getnthreads() threads.
+ *
+ * Output buffers have to be preallocated
+ * */
+int tsp_solve_beam(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
+/**
+ * Set the number of partial tours kept at each step
+ * */
+void beam_setwidth(int width);
+
+/**
+ * Set the number of extensions of each partial tour
+ * */
+void beam_setbranching(int branching);
+
+#endif // TSP_BEAM_H_
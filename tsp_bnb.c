@@ -0,0 +1,680 @@
+#include "tsp_bnb.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_greedy.h"
+#include "tsp_heldkarp.h"
+#include "tsp_localsearch.h"
+#include "tsp_onetree.h"
+#include "tsp_vns.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BNB_CANDIDATES 10
+// double bridge kicks per node of the search for the first incumbent
+#define BNB_KICKS 100
+// subgradient iterations of a node, the step is halved after
+// BNB_ASCENT_PATIENCE of them without improvement
+#define BNB_ASCENT_ITERATIONS 50
+#define BNB_ASCENT_PATIENCE   5
+
+/**
+ * Branching decisions from a node up to the root, shared by the
+ * descendants of the node and freed with the last of them
+ * */
+struct bnb_decision {
+	struct bnb_decision* parent;
+	int a, b;
+	int required;
+	int refs;
+};
+
+static void decision_release(struct bnb_decision* decision)
+{
+	while (decision && __atomic_sub_fetch(&decision->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		struct bnb_decision* parent = decision->parent;
+		free(decision);
+		decision = parent;
+	}
+}
+
+struct bnb_node {
+	struct bnb_decision* decisions;
+	double* pi; // penalties of the last ascent, the children start from them
+	double bound;
+	int v, a, b; // edges to branch on, see bnb_child
+};
+
+static void node_free(struct bnb_node* node)
+{
+	decision_release(node->decisions);
+	free(node->pi);
+	free(node);
+}
+
+/**
+ * Open nodes of a thread: the owner pushes and pops at the tail, the
+ * other threads steal at the head
+ * */
+struct bnb_deque {
+	struct bnb_node** items;
+	int head, tail, capacity;
+	pthread_mutex_t lock;
+};
+
+static int deque_push(struct bnb_deque* deque, struct bnb_node* node)
+{
+	int res = 0;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->tail == deque->capacity && deque->head >= deque->capacity / 2) {
+		int size = deque->tail - deque->head;
+		memmove(deque->items, deque->items + deque->head, sizeof(struct bnb_node*) * size);
+		deque->head = 0;
+		deque->tail = size;
+	}
+	if (deque->tail == deque->capacity) {
+		int capacity = deque->capacity ? 2 * deque->capacity : 64;
+		struct bnb_node** items = realloc(deque->items, sizeof(struct bnb_node*) * capacity);
+		if (!items) {
+			res = -1;
+			goto unlock;
+		}
+		deque->items = items;
+		deque->capacity = capacity;
+	}
+	deque->items[deque->tail++] = node;
+
+unlock:
+	pthread_mutex_unlock(&deque->lock);
+	return res;
+}
+
+static struct bnb_node* deque_pop(struct bnb_deque* deque, int steal)
+{
+	struct bnb_node* node = NULL;
+	pthread_mutex_lock(&deque->lock);
+	if (deque->tail > deque->head)
+		node = steal ? deque->items[deque->head++] : deque->items[--deque->tail];
+	if (deque->head == deque->tail)
+		deque->head = deque->tail = 0;
+	pthread_mutex_unlock(&deque->lock);
+	return node;
+}
+
+struct bnb_context {
+	struct tsp* tsp;
+	int nthreads;
+	struct bnb_deque* deques;
+	double bonus; // subtracted from the cost of the required edges
+	int integral; // all the costs are integers
+	int pending;  // nodes in the deques or being expanded
+	int stop;
+	long expanded;
+};
+
+struct bnb_worker {
+	struct bnb_context* ctx;
+	int id;
+	double* costs; // costs of the node being evaluated
+	struct onetree tree;
+	double* best_pi;
+	int* required_degree;
+	int* set; // union find on the paths of required edges
+	int* set_size;
+	int* endpoint; // first endpoint of each path
+	int* tour;
+	int* adjacency;
+};
+
+static int bnb_worker_init(struct bnb_worker* worker, struct bnb_context* ctx, int id)
+{
+	int n = ctx->tsp->nnodes;
+	worker->ctx = ctx;
+	worker->id = id;
+	worker->costs = malloc(sizeof(double) * n * n);
+	worker->best_pi = malloc(sizeof(double) * n);
+	worker->required_degree = malloc(sizeof(int) * n);
+	worker->set = malloc(sizeof(int) * n);
+	worker->set_size = malloc(sizeof(int) * n);
+	worker->endpoint = malloc(sizeof(int) * n);
+	worker->tour = malloc(sizeof(int) * n);
+	worker->adjacency = malloc(sizeof(int) * 2 * n);
+	if (onetree_init(&worker->tree, n))
+		return -1;
+	worker->tree.costs = worker->costs;
+	if (!worker->costs || !worker->best_pi || !worker->required_degree || !worker->set || !worker->set_size ||
+	    !worker->endpoint || !worker->tour || !worker->adjacency)
+		return -1;
+	return 0;
+}
+
+static void bnb_worker_free(struct bnb_worker* worker)
+{
+	onetree_free(&worker->tree);
+	free(worker->costs);
+	free(worker->best_pi);
+	free(worker->required_degree);
+	free(worker->set);
+	free(worker->set_size);
+	free(worker->endpoint);
+	free(worker->tour);
+	free(worker->adjacency);
+}
+
+static int set_find(int* set, int v)
+{
+	while (set[v] != v) {
+		set[v] = set[set[v]];
+		v = set[v];
+	}
+	return v;
+}
+
+static int bnb_prunable(struct bnb_context* ctx, double bound)
+{
+	double upper = tsp_get_solution_value(ctx->tsp);
+	// with integer costs a better tour costs at most upper - 1
+	if (ctx->integral)
+		return bound > upper - 1 + EPSILON;
+	return bound > upper - EPSILON;
+}
+
+/**
+ * Costs of a node in worker->costs: the excluded edges and the ones that
+ * can't be in a tour with the required edges cost infinity, the required
+ * edges are cheaper by ctx->bonus, so that every 1-tree contains them.
+ *
+ * returns the number of required edges, -1 if they can't be in a tour
+ * */
+static int bnb_apply(struct bnb_worker* worker, const struct bnb_decision* decisions)
+{
+	const struct tsp* tsp = worker->ctx->tsp;
+	int n = tsp->nnodes;
+	double* costs = worker->costs;
+	memcpy(costs, tsp->cost_matrix, sizeof(double) * n * n);
+	for (int v = 0; v < n; v++) {
+		worker->required_degree[v] = 0;
+		worker->set[v] = v;
+		worker->set_size[v] = 1;
+		worker->endpoint[v] = -1;
+	}
+
+	int required = 0, cycle = 0;
+	for (const struct bnb_decision* d = decisions; d; d = d->parent) {
+		if (!d->required) {
+			costs[flatten_coords(d->a, d->b, n)] = costs[flatten_coords(d->b, d->a, n)] = INFINITY;
+			continue;
+		}
+		required++;
+		if (++worker->required_degree[d->a] > 2 || ++worker->required_degree[d->b] > 2)
+			return -1;
+		int ra = set_find(worker->set, d->a), rb = set_find(worker->set, d->b);
+		if (ra == rb) {
+			cycle = 1;
+			continue;
+		}
+		worker->set[rb] = ra;
+		worker->set_size[ra] += worker->set_size[rb];
+	}
+	// the required edges can close a cycle only as a whole tour
+	if (cycle && required < n)
+		return -1;
+
+	for (int v = 0; v < n; v++) {
+		if (worker->required_degree[v] == 2) {
+			for (int u = 0; u < n; u++)
+				costs[flatten_coords(v, u, n)] = costs[flatten_coords(u, v, n)] = INFINITY;
+		} else if (worker->required_degree[v] == 1) {
+			// the edge between the endpoints of a path would close a subtour
+			int root = set_find(worker->set, v);
+			if (worker->set_size[root] == n)
+				continue;
+			if (worker->endpoint[root] < 0) {
+				worker->endpoint[root] = v;
+			} else {
+				int u = worker->endpoint[root];
+				costs[flatten_coords(v, u, n)] = costs[flatten_coords(u, v, n)] = INFINITY;
+			}
+		}
+	}
+
+	for (const struct bnb_decision* d = decisions; d; d = d->parent) {
+		if (d->required) {
+			double cost = tsp->cost_matrix[flatten_coords(d->a, d->b, n)] - worker->ctx->bonus;
+			costs[flatten_coords(d->a, d->b, n)] = costs[flatten_coords(d->b, d->a, n)] = cost;
+		}
+	}
+	return required;
+}
+
+/**
+ * Subgradient ascent from pi with the Polyak step towards the incumbent.
+ * It ends early if the node can be pruned or its 1-tree is a tour,
+ * otherwise pi is set back to the best penalties and the 1-tree is
+ * computed with them.
+ *
+ * returns the bound of the node
+ * */
+static double bnb_ascent(struct bnb_worker* worker, double* pi, int required)
+{
+	struct bnb_context* ctx = worker->ctx;
+	int n = ctx->tsp->nnodes;
+	struct onetree* tree = &worker->tree;
+	double shift = ctx->bonus * required;
+	double best = -INFINITY;
+	double alpha = 2;
+	int stall = 0;
+	for (int iteration = 0; iteration < BNB_ASCENT_ITERATIONS; iteration++) {
+		if (onetree_compute(ctx->tsp, NULL, pi, tree))
+			return INFINITY;
+		double bound = tree->value + shift;
+		if (bound > best + EPSILON) {
+			best = bound;
+			memcpy(worker->best_pi, pi, sizeof(double) * n);
+			stall = 0;
+		} else if (++stall == BNB_ASCENT_PATIENCE) {
+			alpha /= 2;
+			stall = 0;
+		}
+		if (bnb_prunable(ctx, bound))
+			return bound;
+
+		long norm = 0;
+		for (int v = 0; v < n; v++)
+			norm += (long)(tree->degree[v] - 2) * (tree->degree[v] - 2);
+		if (norm == 0)
+			return bound;
+		double step = alpha * (tsp_get_solution_value(ctx->tsp) - bound) / norm;
+		for (int v = 0; v < n; v++)
+			pi[v] += step * (tree->degree[v] - 2);
+	}
+
+	memcpy(pi, worker->best_pi, sizeof(double) * n);
+	if (onetree_compute(ctx->tsp, NULL, pi, tree))
+		return INFINITY;
+	return best;
+}
+
+/**
+ * Saves the tour given by a 1-tree where every node has degree 2
+ * */
+static void bnb_save_tour(struct bnb_worker* worker)
+{
+	struct tsp* tsp = worker->ctx->tsp;
+	int n = tsp->nnodes;
+	struct onetree* tree = &worker->tree;
+	int* adjacency = worker->adjacency;
+	for (int v = 0; v < 2 * n; v++)
+		adjacency[v] = -1;
+	for (int v = 0; v < n; v++) {
+		int u = v == 0 ? -1 : tree->parent[v];
+		if (u < 0)
+			continue;
+		adjacency[2 * v + (adjacency[2 * v] >= 0)] = u;
+		adjacency[2 * u + (adjacency[2 * u] >= 0)] = v;
+	}
+	for (int e = 0; e < 2; e++) {
+		int v = tree->ends[e];
+		adjacency[2 * v + (adjacency[2 * v] >= 0)] = 0;
+		adjacency[e] = v;
+	}
+
+	int previous = adjacency[1];
+	int current = 0;
+	for (int i = 0; i < n; i++) {
+		worker->tour[i] = current;
+		int next = adjacency[2 * current] != previous ? adjacency[2 * current] : adjacency[2 * current + 1];
+		previous = current;
+		current = next;
+	}
+	double value = tsp_recompute_solution_arg(tsp, worker->tour);
+	tsp_save_solution_shared(tsp, worker->tour, value, (int)__atomic_load_n(&worker->ctx->expanded, __ATOMIC_RELAXED));
+}
+
+/**
+ * The node of largest degree in the 1-tree and its two cheapest free
+ * edges (v, a) and (v, b). If v already has a required edge only (v, a)
+ * is used, since requiring it fixes the edges of v
+ * */
+static void bnb_branching_edges(struct bnb_worker* worker, struct bnb_node* node)
+{
+	const struct tsp* tsp = worker->ctx->tsp;
+	int n = tsp->nnodes;
+	struct onetree* tree = &worker->tree;
+	int v = 0;
+	for (int u = 1; u < n; u++) {
+		if (tree->degree[u] > tree->degree[v])
+			v = u;
+	}
+
+	double first = INFINITY, second = INFINITY;
+	node->v = v;
+	node->a = node->b = -1;
+	for (int u = 0; u < n; u++) {
+		int adjacent = u != v && ((u > 0 && tree->parent[u] == v) || (v > 0 && tree->parent[v] == u) ||
+					  (u == 0 && (tree->ends[0] == v || tree->ends[1] == v)) ||
+					  (v == 0 && (tree->ends[0] == u || tree->ends[1] == u)));
+		if (!adjacent)
+			continue;
+		double cost = tsp->cost_matrix[flatten_coords(v, u, n)];
+		// the required edges are cheaper, the excluded ones aren't in the tree
+		if (worker->costs[flatten_coords(v, u, n)] != cost)
+			continue;
+		if (cost < first) {
+			second = first;
+			node->b = node->a;
+			first = cost;
+			node->a = u;
+		} else if (cost < second) {
+			second = cost;
+			node->b = u;
+		}
+	}
+	if (worker->required_degree[v] > 0)
+		node->b = -1;
+}
+
+/**
+ * Bounds a node, saves its 1-tree if it is a tour and chooses the edge to
+ * branch on
+ *
+ * returns 1 if the node must be expanded, 0 if it can be closed
+ * */
+static int bnb_evaluate(struct bnb_worker* worker, struct bnb_node* node)
+{
+	int n = worker->ctx->tsp->nnodes;
+	int required = bnb_apply(worker, node->decisions);
+	if (required < 0)
+		return 0;
+	node->bound = bnb_ascent(worker, node->pi, required);
+	if (bnb_prunable(worker->ctx, node->bound))
+		return 0;
+
+	int tour = 1;
+	for (int v = 0; v < n && tour; v++)
+		tour = worker->tree.degree[v] == 2;
+	if (tour) {
+		bnb_save_tour(worker);
+		return 0;
+	}
+	bnb_branching_edges(worker, node);
+	return node->a >= 0;
+}
+
+static struct bnb_decision* decision_push(struct bnb_decision* parent, int a, int b, int required)
+{
+	struct bnb_decision* decision = malloc(sizeof(struct bnb_decision));
+	if (!decision) {
+		decision_release(parent);
+		return NULL;
+	}
+	decision->parent = parent;
+	decision->a = a;
+	decision->b = b;
+	decision->required = required;
+	decision->refs = 1;
+	return decision;
+}
+
+/**
+ * Children of a node branching on (v, a) and (v, b):
+ * 0: (v, a) excluded
+ * 1: (v, a) required, (v, b) excluded
+ * 2: (v, a) and (v, b) required
+ * Without b there are only the first two.
+ * */
+static struct bnb_node* bnb_child(struct bnb_node* node, int child, int n)
+{
+	struct bnb_node* result = malloc(sizeof(struct bnb_node));
+	double* pi = malloc(sizeof(double) * n);
+	if (!result || !pi) {
+		free(result);
+		free(pi);
+		return NULL;
+	}
+	if (node->decisions)
+		__atomic_add_fetch(&node->decisions->refs, 1, __ATOMIC_RELAXED);
+	struct bnb_decision* decisions = decision_push(node->decisions, node->v, node->a, child > 0);
+	if (decisions && node->b >= 0 && child > 0)
+		decisions = decision_push(decisions, node->v, node->b, child == 2);
+	if (!decisions) {
+		free(result);
+		free(pi);
+		return NULL;
+	}
+	memcpy(pi, node->pi, sizeof(double) * n);
+	result->decisions = decisions;
+	result->pi = pi;
+	return result;
+}
+
+/**
+ * Bounds the children of a node, the open ones are pushed from the worst
+ * bound to the best, so that the best is expanded first
+ * */
+static int bnb_expand(struct bnb_worker* worker, struct bnb_node* node)
+{
+	struct bnb_context* ctx = worker->ctx;
+	if (bnb_prunable(ctx, node->bound))
+		return 0;
+
+	struct bnb_node* children[3];
+	int open = 0;
+	for (int child = 0; child < (node->b >= 0 ? 3 : 2); child++) {
+		struct bnb_node* result = bnb_child(node, child, ctx->tsp->nnodes);
+		if (!result) {
+			for (int i = 0; i < open; i++)
+				node_free(children[i]);
+			return -1;
+		}
+		if (!bnb_evaluate(worker, result)) {
+			node_free(result);
+			continue;
+		}
+		int i = open++;
+		for (; i > 0 && children[i - 1]->bound < result->bound; i--)
+			children[i] = children[i - 1];
+		children[i] = result;
+	}
+	for (int i = 0; i < open; i++) {
+		__atomic_add_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+		if (deque_push(&ctx->deques[worker->id], children[i])) {
+			__atomic_sub_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+			for (; i < open; i++)
+				node_free(children[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void* bnb_worker(void* arg)
+{
+	struct bnb_worker* worker = arg;
+	struct bnb_context* ctx = worker->ctx;
+	while (!__atomic_load_n(&ctx->stop, __ATOMIC_RELAXED)) {
+		struct bnb_node* node = deque_pop(&ctx->deques[worker->id], 0);
+		for (int i = 1; !node && i < ctx->nthreads; i++)
+			node = deque_pop(&ctx->deques[(worker->id + i) % ctx->nthreads], 1);
+		if (!node) {
+			// the other threads can still push the children of their nodes
+			if (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) == 0)
+				break;
+			sched_yield();
+			continue;
+		}
+
+		if (bnb_expand(worker, node)) {
+			fprintf(stderr, "Can't expand a node\n");
+			__atomic_store_n(&ctx->stop, 1, __ATOMIC_RELAXED);
+		}
+		node_free(node);
+		__atomic_sub_fetch(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+		__atomic_add_fetch(&ctx->expanded, 1, __ATOMIC_RELAXED);
+		if (tsp_shouldstop(ctx->tsp))
+			__atomic_store_n(&ctx->stop, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+/**
+ * First incumbent: greedy + 2opt/Or-opt, improved with BNB_KICKS * n double
+ * bridge kicks, each one undone if it doesn't lead to a better tour
+ * */
+static int bnb_incumbent(struct tsp* tsp)
+{
+	int n = tsp->nnodes;
+	int res = 0;
+	int* position = malloc(sizeof(int) * n);
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	if (!position || candidates_build(tsp, BNB_CANDIDATES, &cand) || local_search_init(&ls, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+	ls.oropt = 1;
+	int* solution = tsp->solution_permutation;
+	double value;
+	tsp_solve_greedy(tsp, rand() % n, solution, &value);
+	for (int i = 0; i < n; i++)
+		position[solution[i]] = i;
+	local_search_push_all(&ls);
+	local_search_2opt(tsp, &ls, solution, position, &value);
+	tsp_log_incumbent(tsp, 0, value);
+
+	ls.journaling = 1;
+	for (int kick = 1; kick <= BNB_KICKS * n && !tsp_shouldstop(tsp); kick++) {
+		local_search_commit(&ls);
+		double previous = value;
+		int positions[3];
+		generate_3opt_positions(tsp, positions);
+		value += tsp_doublebridge_delta(tsp, positions, solution);
+		tsp_doublebridge_swap(positions, solution, position, &ls);
+		local_search_2opt(tsp, &ls, solution, position, &value);
+		if (value < previous - EPSILON) {
+			tsp_log_incumbent(tsp, kick, value);
+		} else {
+			local_search_undo(&ls, solution, position);
+			value = previous;
+		}
+	}
+	tsp->solution_value = value;
+
+free_buffers:
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
+	return res;
+}
+
+int tsp_solve_bnb(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	// the double bridge kicks of the incumbent need at least 6 nodes, small
+	// instances are solved by dynamic programming instead
+	if (tsp->nnodes <= HELDKARP_MAX_NODES)
+		return tsp_solve_heldkarp(tsp);
+
+	int n = tsp->nnodes;
+	tsp_starttimer(tsp);
+	if (bnb_incumbent(tsp))
+		return -1;
+
+	int res = 0;
+	int nthreads = tsp_getnthreads(tsp);
+	struct bnb_context ctx = {.tsp = tsp, .nthreads = nthreads, .integral = 1};
+	double max_cost = 0;
+	for (size_t e = 0; e < (size_t)n * n; e++) {
+		double cost = tsp->cost_matrix[e];
+		max_cost = cost > max_cost ? cost : max_cost;
+		if (cost != floor(cost))
+			ctx.integral = 0;
+	}
+	// larger than any difference of penalized costs
+	ctx.bonus = 10 * max_cost + 1;
+
+	struct bnb_worker* workers = calloc(nthreads, sizeof(struct bnb_worker));
+	pthread_t* threads = malloc(sizeof(pthread_t) * nthreads);
+	ctx.deques = calloc(nthreads, sizeof(struct bnb_deque));
+	struct bnb_node* root = calloc(1, sizeof(struct bnb_node));
+	double* pi = calloc(n, sizeof(double));
+	int initialized = 0;
+	if (!workers || !threads || !ctx.deques || !root || !pi) {
+		free(pi);
+		res = -1;
+		goto free_buffers;
+	}
+	root->pi = pi;
+	for (; initialized < nthreads; initialized++) {
+		pthread_mutex_init(&ctx.deques[initialized].lock, NULL);
+		if (bnb_worker_init(&workers[initialized], &ctx, initialized)) {
+			initialized++;
+			res = -1;
+			goto free_buffers;
+		}
+	}
+
+	// full ascent at the root, the nodes only refine its penalties
+	double bound;
+	workers[0].tree.costs = NULL;
+	res = onetree_ascent(tsp, NULL, root->pi, &workers[0].tree, NULL, &bound);
+	workers[0].tree.costs = workers[0].costs;
+	if (res)
+		goto free_buffers;
+	tsp_save_lower_bound(tsp, bound, 0);
+	fprintf(stderr, "Root bound: %lf, incumbent: %lf\n", bound, tsp->solution_value);
+
+	if (bnb_evaluate(&workers[0], root)) {
+		ctx.pending = 1;
+		deque_push(&ctx.deques[0], root);
+		root = NULL;
+	}
+
+	int started = 1;
+	for (; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, bnb_worker, &workers[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	// the deque of a thread that couldn't start is still emptied by stealing
+	bnb_worker(&workers[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	// the bound of the open nodes, if any
+	bound = tsp->solution_value;
+	int open = 0;
+	for (int i = 0; i < nthreads; i++) {
+		struct bnb_node* node;
+		while ((node = deque_pop(&ctx.deques[i], 0))) {
+			bound = node->bound < bound ? node->bound : bound;
+			node_free(node);
+			open++;
+		}
+	}
+	tsp_save_lower_bound(tsp, bound, (int)ctx.expanded);
+	fprintf(stderr, "Branch and bound: %ld nodes in %lf s, %d open, lower bound %lf%s\n", ctx.expanded,
+		tsp_getelapsedseconds(tsp), open, bound, open ? "" : " (optimal)");
+
+free_buffers:
+	for (int i = 0; i < initialized; i++) {
+		bnb_worker_free(&workers[i]);
+		pthread_mutex_destroy(&ctx.deques[i].lock);
+		free(ctx.deques[i].items);
+	}
+	if (root)
+		node_free(root);
+	free(ctx.deques);
+	free(threads);
+	free(workers);
+	return res;
+}
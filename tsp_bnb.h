@@ -0,0 +1,25 @@
+#ifndef TSP_BNB_H_
+#define TSP_BNB_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance exactly with branch and bound, without CPLEX.
+ *
+ * The nodes are bounded with Held-Karp 1-trees: the penalties of the root
+ * come from a full subgradient ascent, each node continues the ascent from
+ * the penalties of its parent. A node branches on a free edge of its
+ * 1-tree incident to a node of degree greater than 2, which is excluded in
+ * one child and required in the other.
+ *
+ * The open nodes are kept in one deque per thread (tsp_getnthreads()):
+ * a thread expands its newest node, an idle thread steals the oldest node
+ * of another one.
+ *
+ * If the time limit is reached the incumbent is returned and the lower
+ * bound of the open nodes is saved in tsp->lower_bound. Instances with at
+ * most HELDKARP_MAX_NODES nodes are handed to tsp_solve_heldkarp.
+ * */
+int tsp_solve_bnb(struct tsp* tsp);
+
+#endif // TSP_BNB_H_
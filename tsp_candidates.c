@@ -0,0 +1,323 @@
+#include "tsp_candidates.h"
+#include "grid.h"
+#include "tsp.h"
+#include "tsp_delaunay.h"
+#include "tsp_onetree.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// nodes per cell of the grid index of the quadrant candidates
+#define CANDIDATES_CELL_NODES 2
+
+int candidates_type = CANDIDATES_NEAREST;
+
+void candidates_settype(int type)
+{
+	candidates_type = type;
+}
+
+int candidates_build(const struct tsp* tsp, int k, struct candidates* cand)
+{
+	switch (candidates_type) {
+	case CANDIDATES_NEAREST:
+		return candidates_build_nearest(tsp, k, cand);
+	case CANDIDATES_ALPHA:
+		return candidates_build_alpha(tsp, k, cand);
+	case CANDIDATES_DELAUNAY:
+		return candidates_build_delaunay(tsp, k, cand);
+	case CANDIDATES_QUADRANT:
+		return candidates_build_quadrant(tsp, k, cand);
+	}
+	return -1;
+}
+
+static int candidates_allocate(struct candidates* cand, int nnodes, int total)
+{
+	cand->nnodes = nnodes;
+	cand->offset = malloc(sizeof(int) * (nnodes + 1));
+	cand->nodes = malloc(sizeof(int) * (total > 0 ? total : 1));
+	if (!cand->offset || !cand->nodes) {
+		candidates_free(cand);
+		return -1;
+	}
+	return 0;
+}
+
+int candidates_build_nearest(const struct tsp* tsp, int k, struct candidates* cand)
+{
+	if (!tsp->cost_matrix || tsp->nnodes < 2)
+		return -1;
+
+	int n = tsp->nnodes;
+	if (k > n - 1)
+		k = n - 1;
+
+	if (candidates_allocate(cand, n, n * k))
+		return -1;
+
+	double* costs = malloc(sizeof(double) * k);
+	for (int i = 0; i < n; i++) {
+		int* nodes = cand->nodes + i * k;
+		int found = 0;
+		for (int j = 0; j < n; j++) {
+			if (i == j)
+				continue;
+			double dist = tsp->cost_matrix[flatten_coords(i, j, n)];
+			if (found == k && dist >= costs[k - 1])
+				continue;
+			// insertion in the sorted list
+			int pos = found < k ? found++ : k - 1;
+			while (pos > 0 && costs[pos - 1] > dist) {
+				costs[pos] = costs[pos - 1];
+				nodes[pos] = nodes[pos - 1];
+				pos--;
+			}
+			costs[pos] = dist;
+			nodes[pos] = j;
+		}
+		cand->offset[i] = i * k;
+	}
+	cand->offset[n] = n * k;
+
+	free(costs);
+	return 0;
+}
+
+/**
+ * Grid index of the nodes over their bounding box
+ * */
+static int grid_build(const struct tsp* tsp, struct grid* grid)
+{
+	int n = tsp->nnodes;
+	double minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY;
+	for (int i = 0; i < n; i++) {
+		minx = tsp->coords[i].x < minx ? tsp->coords[i].x : minx;
+		miny = tsp->coords[i].y < miny ? tsp->coords[i].y : miny;
+		maxx = tsp->coords[i].x > maxx ? tsp->coords[i].x : maxx;
+		maxy = tsp->coords[i].y > maxy ? tsp->coords[i].y : maxy;
+	}
+	if (grid_resize(grid, minx, miny, maxx - minx, maxy - miny, n, CANDIDATES_CELL_NODES))
+		return -1;
+	for (int i = 0; i < n; i++) {
+		int col, row;
+		grid->item_cell[i] = grid_cell(grid, tsp->coords[i].x, tsp->coords[i].y, &col, &row);
+	}
+	grid_fill(grid, n);
+	return 0;
+}
+
+/**
+ * Insertion in the sorted list of the (at most) size nearest nodes
+ * */
+static void nearest_insert(int* nodes, double* dists, int* found, int size, int node, double dist)
+{
+	if (*found == size && dist >= dists[size - 1])
+		return;
+	int pos = *found < size ? (*found)++ : size - 1;
+	while (pos > 0 && dists[pos - 1] > dist) {
+		dists[pos] = dists[pos - 1];
+		nodes[pos] = nodes[pos - 1];
+		pos--;
+	}
+	dists[pos] = dist;
+	nodes[pos] = node;
+}
+
+/**
+ * Quadrant of (dx, dy): counterclockwise from the positive x axis, each one
+ * with one of its two borders. The same point is in quadrant 3.
+ * */
+static inline int quadrant(double dx, double dy)
+{
+	if (dx > 0 && dy >= 0)
+		return 0;
+	if (dx <= 0 && dy > 0)
+		return 1;
+	if (dx < 0 && dy <= 0)
+		return 2;
+	return 3;
+}
+
+int candidates_build_quadrant(const struct tsp* tsp, int k, struct candidates* cand)
+{
+	int n = tsp->nnodes;
+	if (!tsp->coords || n < 2)
+		return -1;
+	if (k > n - 1)
+		k = n - 1;
+	int q = k / 4 > 0 ? k / 4 : 1;
+
+	int res = 0;
+	struct grid grid = {0};
+	// the four quadrant lists, then the list of the k nearest nodes
+	int* nodes = malloc(sizeof(int) * (4 * q + k));
+	double* dists = malloc(sizeof(double) * (4 * q + k));
+	double* costs = malloc(sizeof(double) * k);
+	if (!nodes || !dists || !costs || grid_build(tsp, &grid) || candidates_allocate(cand, n, n * k)) {
+		fprintf(stderr, "Can't allocate the quadrant candidates\n");
+		res = -1;
+		goto free_buffers;
+	}
+
+	int max_ring = grid.cols > grid.rows ? grid.cols : grid.rows;
+	for (int i = 0; i < n; i++) {
+		const struct point* p = tsp->coords + i;
+		int col, row;
+		grid_cell(&grid, p->x, p->y, &col, &row);
+		// ring after which no node of a quadrant is left, as the quadrant
+		// is in the cells on its side of the one of the node
+		int exhausted[4] = {
+			grid.cols - 1 - col > grid.rows - 1 - row ? grid.cols - 1 - col : grid.rows - 1 - row,
+			col > grid.rows - 1 - row ? col : grid.rows - 1 - row,
+			col > row ? col : row,
+			grid.cols - 1 - col > row ? grid.cols - 1 - col : row,
+		};
+		int found[5] = {0};
+
+		for (int ring = 0; ring <= max_ring; ring++) {
+			if (ring > 0) {
+				// nodes in the next rings are farther than reach
+				double reach = (ring - 1) * grid.cell;
+				reach *= reach;
+				int done = found[4] == k && dists[4 * q + k - 1] <= reach;
+				for (int d = 0; d < 4 && done; d++)
+					done = ring - 1 >= exhausted[d] || (found[d] == q && dists[d * q + q - 1] <= reach);
+				if (done)
+					break;
+			}
+			struct grid_ring it;
+			int cell;
+			grid_ring_start(&it, col, row, ring);
+			while ((cell = grid_ring_next(&grid, &it)) >= 0) {
+				for (int a = grid.cell_start[cell]; a < grid.cell_start[cell + 1]; a++) {
+					int j = grid.cell_items[a];
+					if (j == i)
+						continue;
+					double dx = tsp->coords[j].x - p->x, dy = tsp->coords[j].y - p->y;
+					double dist = dx * dx + dy * dy;
+					int d = quadrant(dx, dy);
+					nearest_insert(nodes + d * q, dists + d * q, &found[d], q, j, dist);
+					nearest_insert(nodes + 4 * q, dists + 4 * q, &found[4], k, j, dist);
+				}
+			}
+		}
+
+		// the quadrant lists, completed with the nearest nodes
+		int* list = cand->nodes + i * k;
+		int size = 0;
+		for (int d = 0; d < 4; d++) {
+			for (int a = 0; a < found[d] && size < k; a++)
+				list[size++] = nodes[d * q + a];
+		}
+		for (int a = 0; a < found[4] && size < k; a++) {
+			int j = nodes[4 * q + a];
+			int present = 0;
+			for (int b = 0; b < size && !present; b++)
+				present = list[b] == j;
+			if (!present)
+				list[size++] = j;
+		}
+
+		// sorted by cost
+		for (int a = 0; a < size; a++) {
+			int node = list[a];
+			double cost = tsp_cost(tsp, i, node);
+			int b = a;
+			while (b > 0 && costs[b - 1] > cost) {
+				list[b] = list[b - 1];
+				costs[b] = costs[b - 1];
+				b--;
+			}
+			list[b] = node;
+			costs[b] = cost;
+		}
+		cand->offset[i] = i * k;
+	}
+	cand->offset[n] = n * k;
+
+free_buffers:
+	grid_free(&grid);
+	free(costs);
+	free(dists);
+	free(nodes);
+	return res;
+}
+
+int candidates_symmetrize(const struct tsp* tsp, const struct candidates* cand, struct candidates* out)
+{
+	int n = cand->nnodes;
+	int total = cand->offset[n];
+	int* fill = calloc(n + 1, sizeof(int));
+	int* nodes = malloc(sizeof(int) * (2 * total > 0 ? 2 * total : 1));
+	double* costs = malloc(sizeof(double) * (2 * total > 0 ? 2 * total : 1));
+	int res = 0;
+	if (!fill || !nodes || !costs) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	// both directions of each edge, the duplicates are removed below
+	for (int i = 0; i < n; i++) {
+		for (int c = cand->offset[i]; c < cand->offset[i + 1]; c++) {
+			fill[i + 1]++;
+			fill[cand->nodes[c] + 1]++;
+		}
+	}
+	for (int i = 0; i < n; i++)
+		fill[i + 1] += fill[i];
+	if (candidates_allocate(out, n, 2 * total)) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int i = 0; i <= n; i++)
+		out->offset[i] = fill[i];
+	for (int i = 0; i < n; i++) {
+		for (int c = cand->offset[i]; c < cand->offset[i + 1]; c++) {
+			int j = cand->nodes[c];
+			double cost = tsp_cost(tsp, i, j);
+			nodes[fill[i]] = j;
+			costs[fill[i]++] = cost;
+			nodes[fill[j]] = i;
+			costs[fill[j]++] = cost;
+		}
+	}
+
+	int size = 0;
+	for (int i = 0; i < n; i++) {
+		int begin = out->offset[i], end = out->offset[i + 1];
+		// insertion sort by cost and node, so that the duplicates are adjacent
+		for (int a = begin + 1; a < end; a++) {
+			int node = nodes[a];
+			double cost = costs[a];
+			int b = a;
+			while (b > begin && (costs[b - 1] > cost || (costs[b - 1] == cost && nodes[b - 1] > node))) {
+				nodes[b] = nodes[b - 1];
+				costs[b] = costs[b - 1];
+				b--;
+			}
+			nodes[b] = node;
+			costs[b] = cost;
+		}
+		out->offset[i] = size;
+		for (int a = begin; a < end; a++) {
+			if (a == begin || nodes[a] != nodes[a - 1])
+				out->nodes[size++] = nodes[a];
+		}
+	}
+	out->offset[n] = size;
+
+free_buffers:
+	free(costs);
+	free(nodes);
+	free(fill);
+	return res;
+}
+
+void candidates_free(struct candidates* cand)
+{
+	free(cand->offset);
+	free(cand->nodes);
+	cand->offset = NULL;
+	cand->nodes = NULL;
+}
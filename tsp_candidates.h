@@ -0,0 +1,60 @@
+#ifndef TSP_CANDIDATES_H_
+#define TSP_CANDIDATES_H_
+
+#include "tsp.h"
+
+#define CANDIDATES_NEAREST  0
+#define CANDIDATES_ALPHA    1
+#define CANDIDATES_DELAUNAY 2
+#define CANDIDATES_QUADRANT 3
+
+/**
+ * Sparse candidate graph: the candidates of node i are
+ * nodes[offset[i] ... offset[i + 1] - 1], sorted by cost whatever the rule
+ * that selected them: the moves stop at the first candidate too expensive.
+ *
+ * The graph is not necessarily symmetric.
+ * */
+struct candidates {
+	int nnodes;
+	int* offset;
+	int* nodes;
+};
+
+/**
+ * Select the type of candidate set built by candidates_build
+ * */
+void candidates_settype(int type);
+
+/**
+ * Build the candidate set of the selected type with (about) k candidates
+ * per node
+ * */
+int candidates_build(const struct tsp* tsp, int k, struct candidates* cand);
+
+/**
+ * Build the k nearest neighbour lists using the cost matrix
+ * */
+int candidates_build_nearest(const struct tsp* tsp, int k, struct candidates* cand);
+
+/**
+ * Build quadrant neighbour lists: the k / 4 nearest nodes in each of the
+ * four quadrants around the node, completed with the nearest nodes up to
+ * k. On clustered instances they keep edges towards the nearby clusters,
+ * that are missing from the plain nearest neighbour lists.
+ *
+ * The nodes are found with a uniform grid index over the coordinates,
+ * visiting the rings of cells around each node until the lists can't
+ * change, so the cost matrix is not needed.
+ * */
+int candidates_build_quadrant(const struct tsp* tsp, int k, struct candidates* cand);
+
+/**
+ * Symmetric version of a candidate graph: j is a candidate of i in out if
+ * it is in cand either j of i or i of j. The lists are sorted by cost.
+ * */
+int candidates_symmetrize(const struct tsp* tsp, const struct candidates* cand, struct candidates* out);
+
+void candidates_free(struct candidates* cand);
+
+#endif // TSP_CANDIDATES_H_
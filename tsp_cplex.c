@@ -832,13 +832,20 @@ int cplex_add_start(CPXENVptr env, CPXLPptr lp, double* solution, int ncols)
 	return res;
 }
 
+tsp_constructor warm_constructor = tsp_solve_greedy;
+
+void cplex_setwarmstart(tsp_constructor constructor)
+{
+	warm_constructor = constructor;
+}
+
 int cplex_warm_start(struct tsp* tsp, CPXENVptr env, CPXLPptr lp)
 {
 	double total = tsp->timelimit_secs;
 	tsp->timelimit_secs = total / 10;
 	// warm start: find a solution using an heuristic and pass it to CPLEX
 
-	int greedyres = tsp_solve_multigreedy(tsp, 1);
+	int greedyres = tsp_solve_multistart(tsp, warm_constructor, 1);
 	if (greedyres) {
 		fprintf(stderr, "Can't generate heuristic\n");
 		return 1;
@@ -2,6 +2,7 @@
 #define TSP_CPLEX_
 
 #include "tsp.h"
+#include "tsp_greedy.h"
 #include <ilcplex/cplex.h>
 
 int tsp_build_lpmodel(struct tsp* tsp, CPXENVptr env, CPXLPptr lp);
@@ -24,6 +25,12 @@ int tsp_solve_branchcut_for_matheuristic(struct tsp* tsp,
  * */
 int tsp_perm_to_cplex(const struct tsp* tsp, const int* perm, double* cplex_sol, int ncols);
 int cplex_warm_start(struct tsp* tsp, CPXENVptr env, CPXLPptr lp);
+
+/**
+ * Set the construction heuristic of the multistart (+ 2opt) used by
+ * cplex_warm_start, tsp_solve_greedy by default
+ * */
+void cplex_setwarmstart(tsp_constructor constructor);
 int cplex_add_start(CPXENVptr env, CPXLPptr lp, double* solution, int ncols);
 
 #endif
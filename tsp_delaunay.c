@@ -0,0 +1,518 @@
+#include "tsp_delaunay.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// edges waiting to be legalized, only exceeded on degenerate inputs
+#define DELAUNAY_STACK 512
+
+/**
+ * Triangulation in halfedge form (as in Delaunator): halfedge e goes from
+ * triangles[e] to the next vertex of its triangle, halfedges[e] is the
+ * opposite halfedge in the adjacent triangle, -1 on the convex hull.
+ *
+ * The hull is a circular list of nodes, hashed by their angle around the
+ * center of the seed triangle to find a visible edge quickly.
+ * */
+struct delaunay {
+	const struct point* coords;
+	int* triangles;
+	int* halfedges;
+	int size; // number of halfedges
+
+	int* hull_prev;
+	int* hull_next;
+	int* hull_tri; // hull halfedge leaving each hull node
+	int* hull_hash;
+	int hash_size;
+	int hull_start;
+	double cx;
+	double cy;
+
+	int stack[DELAUNAY_STACK];
+};
+
+struct delaunay_key {
+	double key;
+	int node;
+};
+
+static int compare_keys(const void* a, const void* b)
+{
+	const struct delaunay_key* x = a;
+	const struct delaunay_key* y = b;
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->node - y->node;
+}
+
+struct delaunay_point {
+	double x;
+	double y;
+	int node;
+};
+
+static int compare_points(const void* a, const void* b)
+{
+	const struct delaunay_point* p = a;
+	const struct delaunay_point* q = b;
+	if (p->x != q->x)
+		return p->x < q->x ? -1 : 1;
+	if (p->y != q->y)
+		return p->y < q->y ? -1 : 1;
+	return p->node - q->node;
+}
+
+/**
+ * 1 if r is on the right of p -> q
+ * */
+static inline int orient(const struct point* p, const struct point* q, const struct point* r)
+{
+	return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y) < 0;
+}
+
+/**
+ * 1 if p is strictly inside the circle through a, b, c
+ * */
+static inline int in_circle(const struct point* a, const struct point* b, const struct point* c, const struct point* p)
+{
+	double dx = a->x - p->x, dy = a->y - p->y;
+	double ex = b->x - p->x, ey = b->y - p->y;
+	double fx = c->x - p->x, fy = c->y - p->y;
+	double ap = dx * dx + dy * dy;
+	double bp = ex * ex + ey * ey;
+	double cp = fx * fx + fy * fy;
+	return dx * (ey * cp - bp * fy) - dy * (ex * cp - bp * fx) + ap * (ex * fy - ey * fx) < 0;
+}
+
+/**
+ * Center of the circle through a, b, c relative to a, infinite or NaN if
+ * they are collinear
+ * */
+static void circumcenter(const struct point* a, const struct point* b, const struct point* c, double* x, double* y)
+{
+	double dx = b->x - a->x, dy = b->y - a->y;
+	double ex = c->x - a->x, ey = c->y - a->y;
+	double bl = dx * dx + dy * dy;
+	double cl = ex * ex + ey * ey;
+	double d = 0.5 / (dx * ey - dy * ex);
+	*x = (ey * bl - dy * cl) * d;
+	*y = (dx * cl - ex * bl) * d;
+}
+
+static inline double squared_distance(const struct point* a, const struct point* b)
+{
+	double dx = a->x - b->x, dy = a->y - b->y;
+	return dx * dx + dy * dy;
+}
+
+static int hash_key(const struct delaunay* d, const struct point* p)
+{
+	double dx = p->x - d->cx, dy = p->y - d->cy;
+	if (dx == 0 && dy == 0)
+		return 0;
+	// monotone in the angle, in [0, 1]
+	double t = dx / (fabs(dx) + fabs(dy));
+	double angle = (dy > 0 ? 3 - t : 1 + t) / 4;
+	return (int)(angle * d->hash_size) % d->hash_size;
+}
+
+static inline void link(struct delaunay* d, int a, int b)
+{
+	d->halfedges[a] = b;
+	if (b != -1)
+		d->halfedges[b] = a;
+}
+
+static int add_triangle(struct delaunay* d, int i0, int i1, int i2, int a, int b, int c)
+{
+	int t = d->size;
+	d->triangles[t] = i0;
+	d->triangles[t + 1] = i1;
+	d->triangles[t + 2] = i2;
+	link(d, t, a);
+	link(d, t + 1, b);
+	link(d, t + 2, c);
+	d->size += 3;
+	return t;
+}
+
+/**
+ * Flip the edges starting from halfedge a until the triangles around it
+ * satisfy the Delaunay condition
+ *
+ * returns the halfedge that replaced the one before a in its triangle
+ * */
+static int legalize(struct delaunay* d, int a)
+{
+	int depth = 0;
+	int ar;
+	for (;;) {
+		int b = d->halfedges[a];
+		int a0 = a - a % 3;
+		ar = a0 + (a + 2) % 3;
+		if (b == -1) {
+			if (depth == 0)
+				break;
+			a = d->stack[--depth];
+			continue;
+		}
+
+		int b0 = b - b % 3;
+		int al = a0 + (a + 1) % 3;
+		int bl = b0 + (b + 2) % 3;
+		int p0 = d->triangles[ar];
+		int pr = d->triangles[a];
+		int pl = d->triangles[al];
+		int p1 = d->triangles[bl];
+		if (!in_circle(d->coords + p0, d->coords + pr, d->coords + pl, d->coords + p1)) {
+			if (depth == 0)
+				break;
+			a = d->stack[--depth];
+			continue;
+		}
+
+		d->triangles[a] = p1;
+		d->triangles[b] = p0;
+		int hbl = d->halfedges[bl];
+		// the flipped edge was on the hull
+		if (hbl == -1) {
+			int e = d->hull_start;
+			do {
+				if (d->hull_tri[e] == bl) {
+					d->hull_tri[e] = a;
+					break;
+				}
+				e = d->hull_prev[e];
+			} while (e != d->hull_start);
+		}
+		link(d, a, hbl);
+		link(d, b, d->halfedges[ar]);
+		link(d, ar, bl);
+		if (depth < DELAUNAY_STACK)
+			d->stack[depth++] = b0 + (b + 1) % 3;
+	}
+	return ar;
+}
+
+/**
+ * Triangulate the distinct points nodes[0 ... m - 1], m >= 3.
+ *
+ * The seed triangle is the smallest circle around the node closest to the
+ * center of the bounding box, then the nodes are added to the hull in
+ * increasing distance from its center, so that each one is outside the
+ * current hull: the triangles with the visible hull edges are added and
+ * legalized by flipping.
+ *
+ * Nodes that can't be inserted (only with numerical trouble) are joined to
+ * a hull node in *fallback, -1 otherwise. returns 1 if the points are
+ * collinear, with nothing triangulated.
+ * */
+static int delaunay_triangulate(struct delaunay* d, const int* nodes, int m, struct delaunay_key* keys, int* fallback)
+{
+	const struct point* coords = d->coords;
+	double minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY;
+	for (int k = 0; k < m; k++) {
+		const struct point* p = coords + nodes[k];
+		minx = p->x < minx ? p->x : minx;
+		miny = p->y < miny ? p->y : miny;
+		maxx = p->x > maxx ? p->x : maxx;
+		maxy = p->y > maxy ? p->y : maxy;
+	}
+	struct point center = {(minx + maxx) / 2, (miny + maxy) / 2};
+
+	int i0 = -1, i1 = -1, i2 = -1;
+	double best = INFINITY;
+	for (int k = 0; k < m; k++) {
+		double dist = squared_distance(&center, coords + nodes[k]);
+		if (dist < best) {
+			i0 = nodes[k];
+			best = dist;
+		}
+	}
+	best = INFINITY;
+	for (int k = 0; k < m; k++) {
+		double dist = squared_distance(coords + i0, coords + nodes[k]);
+		if (nodes[k] != i0 && dist < best) {
+			i1 = nodes[k];
+			best = dist;
+		}
+	}
+	best = INFINITY;
+	for (int k = 0; k < m; k++) {
+		if (nodes[k] == i0 || nodes[k] == i1)
+			continue;
+		double x, y;
+		circumcenter(coords + i0, coords + i1, coords + nodes[k], &x, &y);
+		double radius = x * x + y * y;
+		if (radius < best) {
+			i2 = nodes[k];
+			best = radius;
+		}
+	}
+	if (i2 == -1)
+		return 1;
+
+	if (orient(coords + i0, coords + i1, coords + i2)) {
+		int tmp = i1;
+		i1 = i2;
+		i2 = tmp;
+	}
+	circumcenter(coords + i0, coords + i1, coords + i2, &d->cx, &d->cy);
+	d->cx += coords[i0].x;
+	d->cy += coords[i0].y;
+
+	struct point seed_center = {d->cx, d->cy};
+	for (int k = 0; k < m; k++) {
+		keys[k].key = squared_distance(&seed_center, coords + nodes[k]);
+		keys[k].node = nodes[k];
+	}
+	qsort(keys, m, sizeof(struct delaunay_key), compare_keys);
+
+	d->hash_size = (int)ceil(sqrt(m));
+	for (int h = 0; h < d->hash_size; h++)
+		d->hull_hash[h] = -1;
+	d->hull_start = i0;
+	d->hull_next[i0] = d->hull_prev[i2] = i1;
+	d->hull_next[i1] = d->hull_prev[i0] = i2;
+	d->hull_next[i2] = d->hull_prev[i1] = i0;
+	d->hull_tri[i0] = 0;
+	d->hull_tri[i1] = 1;
+	d->hull_tri[i2] = 2;
+	d->hull_hash[hash_key(d, coords + i0)] = i0;
+	d->hull_hash[hash_key(d, coords + i1)] = i1;
+	d->hull_hash[hash_key(d, coords + i2)] = i2;
+	d->size = 0;
+	add_triangle(d, i0, i1, i2, -1, -1, -1);
+
+	for (int k = 0; k < m; k++) {
+		int i = keys[k].node;
+		const struct point* p = coords + i;
+		if (i == i0 || i == i1 || i == i2)
+			continue;
+
+		// a hull edge visible from p, starting from the hashed angle
+		int start = 0;
+		int key = hash_key(d, p);
+		for (int h = 0; h < d->hash_size; h++) {
+			start = d->hull_hash[(key + h) % d->hash_size];
+			if (start != -1 && start != d->hull_next[start])
+				break;
+		}
+		start = d->hull_prev[start];
+		int e = start, q;
+		while (q = d->hull_next[e], !orient(p, coords + e, coords + q)) {
+			e = q;
+			if (e == start) {
+				e = -1;
+				break;
+			}
+		}
+		if (e == -1) {
+			fallback[i] = start;
+			continue;
+		}
+
+		int t = add_triangle(d, e, i, d->hull_next[e], -1, -1, d->hull_tri[e]);
+		d->hull_tri[i] = legalize(d, t + 2);
+		d->hull_tri[e] = t;
+
+		// walk forward along the hull adding the visible edges
+		int next = d->hull_next[e];
+		while (q = d->hull_next[next], orient(p, coords + next, coords + q)) {
+			t = add_triangle(d, next, i, q, d->hull_tri[i], -1, d->hull_tri[next]);
+			d->hull_tri[i] = legalize(d, t + 2);
+			d->hull_next[next] = next; // removed from the hull
+			next = q;
+		}
+		// and backward
+		if (e == start) {
+			while (q = d->hull_prev[e], orient(p, coords + q, coords + e)) {
+				t = add_triangle(d, q, i, e, -1, d->hull_tri[e], d->hull_tri[q]);
+				legalize(d, t + 2);
+				d->hull_tri[q] = t;
+				d->hull_next[e] = e;
+				e = q;
+			}
+		}
+
+		d->hull_start = d->hull_prev[i] = e;
+		d->hull_next[e] = d->hull_prev[next] = i;
+		d->hull_next[i] = next;
+		d->hull_hash[hash_key(d, p)] = i;
+		d->hull_hash[hash_key(d, coords + e)] = e;
+	}
+	return 0;
+}
+
+int delaunay_edges(const struct tsp* tsp, const int* nodes, int count, int* from, int* to)
+{
+	int n = tsp->nnodes;
+	if (!tsp->coords)
+		return -1;
+
+	int nedges = 0;
+	struct delaunay d = {.coords = tsp->coords};
+	struct delaunay_point* points = malloc(sizeof(struct delaunay_point) * (count > 0 ? count : 1));
+	int* distinct = malloc(sizeof(int) * (count > 0 ? count : 1));
+	struct delaunay_key* keys = malloc(sizeof(struct delaunay_key) * (count > 0 ? count : 1));
+	int max_halfedges = 3 * (2 * count - 5 > 1 ? 2 * count - 5 : 1);
+	d.triangles = malloc(sizeof(int) * max_halfedges);
+	d.halfedges = malloc(sizeof(int) * max_halfedges);
+	// indexed by node
+	int* fallback = malloc(sizeof(int) * n);
+	double* nearest_dist = malloc(sizeof(double) * n);
+	d.hull_prev = malloc(sizeof(int) * n);
+	d.hull_next = malloc(sizeof(int) * n);
+	d.hull_tri = malloc(sizeof(int) * n);
+	d.hull_hash = malloc(sizeof(int) * ((int)ceil(sqrt(count)) + 1));
+	if (!points || !distinct || !keys || !d.triangles || !d.halfedges || !fallback || !nearest_dist ||
+	    !d.hull_prev || !d.hull_next || !d.hull_tri || !d.hull_hash) {
+		fprintf(stderr, "Can't allocate the Delaunay triangulation\n");
+		nedges = -1;
+		goto free_buffers;
+	}
+
+	// duplicate nodes are left out and joined in a path to the first copy
+	for (int i = 0; i < count; i++) {
+		points[i].x = tsp->coords[nodes[i]].x;
+		points[i].y = tsp->coords[nodes[i]].y;
+		points[i].node = nodes[i];
+		fallback[nodes[i]] = -1;
+	}
+	qsort(points, count, sizeof(struct delaunay_point), compare_points);
+	int m = 0;
+	for (int i = 0; i < count; i++) {
+		if (i > 0 && points[i].x == points[i - 1].x && points[i].y == points[i - 1].y) {
+			from[nedges] = points[i].node;
+			to[nedges++] = points[i - 1].node;
+		} else {
+			distinct[m++] = points[i].node;
+		}
+	}
+
+	int first_edge = nedges;
+	int collinear = m < 3 || delaunay_triangulate(&d, distinct, m, keys, fallback);
+	if (collinear) {
+		// a path along the line, the nodes are sorted by x then y
+		for (int i = 1; i < m; i++) {
+			from[nedges] = distinct[i - 1];
+			to[nedges++] = distinct[i];
+		}
+	} else {
+		for (int e = 0; e < d.size; e++) {
+			if (d.halfedges[e] > e)
+				continue;
+			from[nedges] = d.triangles[e];
+			to[nedges++] = d.triangles[e % 3 == 2 ? e - 2 : e + 1];
+		}
+		for (int i = 0; i < m; i++) {
+			if (fallback[distinct[i]] != -1) {
+				from[nedges] = distinct[i];
+				to[nedges++] = fallback[distinct[i]];
+			}
+		}
+	}
+
+	// the last copy of a duplicate node is joined to the nearest neighbour
+	// of the first one (to the first one if all the nodes are copies), so
+	// every copy has two edges
+	if (m == count)
+		goto free_buffers;
+	int* nearest = fallback;
+	for (int i = 0; i < m; i++)
+		nearest[distinct[i]] = -1;
+	for (int e = first_edge; e < nedges; e++) {
+		int u = from[e], v = to[e];
+		double dx = tsp->coords[u].x - tsp->coords[v].x;
+		double dy = tsp->coords[u].y - tsp->coords[v].y;
+		double dist = dx * dx + dy * dy;
+		if (nearest[u] == -1 || dist < nearest_dist[u]) {
+			nearest[u] = v;
+			nearest_dist[u] = dist;
+		}
+		if (nearest[v] == -1 || dist < nearest_dist[v]) {
+			nearest[v] = u;
+			nearest_dist[v] = dist;
+		}
+	}
+	for (int i = 0, first = -1; i < count; i++) {
+		if (i == 0 || points[i].x != points[i - 1].x || points[i].y != points[i - 1].y)
+			first = points[i].node;
+		else if (i + 1 == count || points[i + 1].x != points[i].x || points[i + 1].y != points[i].y) {
+			int v = nearest[first] != -1 ? nearest[first] : first;
+			if (v != points[i - 1].node) {
+				from[nedges] = points[i].node;
+				to[nedges++] = v;
+			}
+		}
+	}
+
+free_buffers:
+	free(d.hull_hash);
+	free(d.hull_tri);
+	free(d.hull_next);
+	free(d.hull_prev);
+	free(nearest_dist);
+	free(fallback);
+	free(d.halfedges);
+	free(d.triangles);
+	free(keys);
+	free(distinct);
+	free(points);
+	return nedges;
+}
+
+int candidates_build_delaunay(const struct tsp* tsp, int k, struct candidates* cand)
+{
+	(void)k;
+	int n = tsp->nnodes;
+	if (n < 2)
+		return -1;
+
+	int res = 0;
+	struct candidates edges = {0};
+	int* nodes = malloc(sizeof(int) * n);
+	int* fill = malloc(sizeof(int) * n);
+	int* from = malloc(sizeof(int) * 3 * n);
+	int* to = malloc(sizeof(int) * 3 * n);
+	if (!nodes || !fill || !from || !to) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int i = 0; i < n; i++)
+		nodes[i] = i;
+	int nedges = delaunay_edges(tsp, nodes, n, from, to);
+	if (nedges < 0) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	// each edge once in the list of from, then in both directions
+	edges.nnodes = n;
+	edges.offset = calloc(n + 1, sizeof(int));
+	edges.nodes = malloc(sizeof(int) * (nedges > 0 ? nedges : 1));
+	if (!edges.offset || !edges.nodes) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int e = 0; e < nedges; e++)
+		edges.offset[from[e] + 1]++;
+	for (int i = 0; i < n; i++)
+		edges.offset[i + 1] += edges.offset[i];
+	for (int i = 0; i < n; i++)
+		fill[i] = edges.offset[i];
+	for (int e = 0; e < nedges; e++)
+		edges.nodes[fill[from[e]]++] = to[e];
+	res = candidates_symmetrize(tsp, &edges, cand);
+
+free_buffers:
+	candidates_free(&edges);
+	free(to);
+	free(from);
+	free(fill);
+	free(nodes);
+	return res;
+}
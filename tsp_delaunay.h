@@ -0,0 +1,31 @@
+#ifndef TSP_DELAUNAY_H_
+#define TSP_DELAUNAY_H_
+
+#include "tsp.h"
+#include "tsp_candidates.h"
+
+/**
+ * Edges of the Delaunay triangulation of nodes[0 ... count - 1], each one
+ * once as (from[e], to[e]). The triangulation is computed with a sweep
+ * hull in O(count log count) reading only tsp->coords. The copies of a
+ * duplicate node form a path from the first one, the last copy is also
+ * joined to the nearest neighbour of the first. Collinear nodes form a
+ * path.
+ *
+ * from and to must hold 3 * count edges
+ *
+ * returns the number of edges, -1 on error
+ * */
+int delaunay_edges(const struct tsp* tsp, const int* nodes, int count, int* from, int* to);
+
+/**
+ * Candidate lists made of the edges of the Delaunay triangulation of the
+ * coordinates, sorted by cost. The graph is symmetric, with less than 6
+ * neighbours per node on average, and contains the minimum spanning tree
+ * and almost all the edges of an optimal tour. k is ignored.
+ *
+ * The lists are sorted with tsp_cost, so the cost matrix is never needed.
+ * */
+int candidates_build_delaunay(const struct tsp* tsp, int k, struct candidates* cand);
+
+#endif // TSP_DELAUNAY_H_
@@ -0,0 +1,667 @@
+#include "tsp_genetic.h"
+#include "eventlog.h"
+#include "tourhash.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_gpx.h"
+#include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include "util.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GENETIC_CANDIDATES 10
+
+int population_size = 30;
+int offspring = 10;
+
+void genetic_setpopulation(int size)
+{
+	population_size = size;
+}
+
+void genetic_setoffspring(int count)
+{
+	offspring = count;
+}
+
+/**
+ * Individuals of a generation in a single arena: the tour of individual i
+ * is tours[i * nnodes ... (i + 1) * nnodes - 1]
+ * */
+struct population {
+	int size;
+	int nnodes;
+	int* tours;
+	double* values;
+	uint64_t* hashes;
+};
+
+static int population_init(struct population* pop, int size, int nnodes)
+{
+	pop->size = size;
+	pop->nnodes = nnodes;
+	pop->tours = malloc(sizeof(int) * (size_t)size * nnodes);
+	pop->values = malloc(sizeof(double) * size);
+	pop->hashes = malloc(sizeof(uint64_t) * size);
+	if (!pop->tours || !pop->values || !pop->hashes)
+		return -1;
+	return 0;
+}
+
+static void population_free(struct population* pop)
+{
+	free(pop->tours);
+	free(pop->values);
+	free(pop->hashes);
+}
+
+static inline int* population_tour(const struct population* pop, int i)
+{
+	return pop->tours + (size_t)i * pop->nnodes;
+}
+
+static int population_contains(const struct population* pop, uint64_t hash)
+{
+	for (int i = 0; i < pop->size; i++) {
+		if (pop->hashes[i] == hash)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Buffers used by a thread to build the children of a pair of parents
+ * */
+struct eax_workspace {
+	int nnodes;
+	int* adj_a; // the two neighbours of each node in A
+	int* adj_b;
+	int* child;
+	// A-only (slots 0, 1) and B-only (slots 2, 3) edges of each node not
+	// used by an AB-cycle yet
+	int* remaining;
+	int* nremaining;
+	int* path;
+	int* path_index; // index in the path of each node, for each parity
+	// nodes of the AB-cycles, the edge leaving an even position is in A
+	int* cycles;
+	int* cycle_offset;
+	int ncycles;
+	int* cycle_order;
+	int* label; // subtour of each node of the child
+	int* subtour_size;
+	int* subtour_node;
+	int* members;
+	int* solution;
+	int* position;
+	int* best_solution;
+	struct local_search ls;
+	struct rng rng;
+};
+
+static void workspace_free(struct eax_workspace* ws)
+{
+	free(ws->adj_a);
+	free(ws->adj_b);
+	free(ws->child);
+	free(ws->remaining);
+	free(ws->nremaining);
+	free(ws->path);
+	free(ws->path_index);
+	free(ws->cycles);
+	free(ws->cycle_offset);
+	free(ws->cycle_order);
+	free(ws->label);
+	free(ws->subtour_size);
+	free(ws->subtour_node);
+	free(ws->members);
+	free(ws->solution);
+	free(ws->position);
+	free(ws->best_solution);
+	local_search_free(&ws->ls);
+}
+
+static int workspace_init(struct eax_workspace* ws, const struct candidates* cand, int n, uint64_t seed)
+{
+	memset(ws, 0, sizeof(struct eax_workspace));
+	ws->nnodes = n;
+	ws->adj_a = malloc(sizeof(int) * 2 * n);
+	ws->adj_b = malloc(sizeof(int) * 2 * n);
+	ws->child = malloc(sizeof(int) * 2 * n);
+	ws->remaining = malloc(sizeof(int) * 4 * n);
+	ws->nremaining = malloc(sizeof(int) * 2 * n);
+	ws->path = malloc(sizeof(int) * (2 * n + 1));
+	ws->path_index = malloc(sizeof(int) * 2 * n);
+	ws->cycles = malloc(sizeof(int) * 2 * n);
+	ws->cycle_offset = malloc(sizeof(int) * (n + 1));
+	ws->cycle_order = malloc(sizeof(int) * n);
+	ws->label = malloc(sizeof(int) * n);
+	ws->subtour_size = malloc(sizeof(int) * n);
+	ws->subtour_node = malloc(sizeof(int) * n);
+	ws->members = malloc(sizeof(int) * n);
+	ws->solution = malloc(sizeof(int) * n);
+	ws->position = malloc(sizeof(int) * n);
+	ws->best_solution = malloc(sizeof(int) * n);
+	rng_seed(&ws->rng, seed);
+	if (!ws->adj_a || !ws->adj_b || !ws->child || !ws->remaining || !ws->nremaining || !ws->path ||
+	    !ws->path_index || !ws->cycles || !ws->cycle_offset || !ws->cycle_order || !ws->label ||
+	    !ws->subtour_size || !ws->subtour_node || !ws->members || !ws->solution || !ws->position ||
+	    !ws->best_solution || local_search_init(&ws->ls, cand))
+		return -1;
+	ws->ls.oropt = 1;
+	return 0;
+}
+
+static inline void adj_replace(int* adj, int u, int old, int new)
+{
+	if (adj[2 * u] == old)
+		adj[2 * u] = new;
+	else
+		adj[2 * u + 1] = new;
+}
+
+/**
+ * Removes the edge (u, w) of the given type (0 A, 1 B) from the edges
+ * available to the AB-cycles
+ * */
+static void remove_remaining(struct eax_workspace* ws, int type, int u, int w)
+{
+	for (int side = 0; side < 2; side++) {
+		int* slots = ws->remaining + 4 * u + 2 * type;
+		int* count = ws->nremaining + 2 * u + type;
+		if (slots[0] == w && *count == 2)
+			slots[0] = slots[1];
+		(*count)--;
+		int t = u;
+		u = w;
+		w = t;
+	}
+}
+
+/**
+ * Decomposes the edges in A but not in B and in B but not in A into
+ * AB-cycles, walking randomly and alternating A and B edges
+ * */
+static void build_ab_cycles(struct eax_workspace* ws)
+{
+	int n = ws->nnodes;
+	for (int v = 0; v < n; v++) {
+		ws->nremaining[2 * v] = 0;
+		ws->nremaining[2 * v + 1] = 0;
+		for (int k = 0; k < 2; k++) {
+			int w = ws->adj_a[2 * v + k];
+			if (!adjacency_has_edge(ws->adj_b, v, w))
+				ws->remaining[4 * v + ws->nremaining[2 * v]++] = w;
+			w = ws->adj_b[2 * v + k];
+			if (!adjacency_has_edge(ws->adj_a, v, w))
+				ws->remaining[4 * v + 2 + ws->nremaining[2 * v + 1]++] = w;
+		}
+	}
+	for (int i = 0; i < 2 * n; i++)
+		ws->path_index[i] = -1;
+
+	ws->ncycles = 0;
+	ws->cycle_offset[0] = 0;
+	int ncycle_nodes = 0;
+	int first = rng_randint(&ws->rng, n);
+	for (int t = 0; t < n; t++) {
+		int start = (first + t) % n;
+		if (ws->nremaining[2 * start] == 0)
+			continue;
+
+		int len = 0;
+		ws->path[0] = start;
+		ws->path_index[2 * start] = 0;
+		while (1) {
+			int current = ws->path[len];
+			int type = len % 2; // the edge leaving an even position is in A
+			int count = ws->nremaining[2 * current + type];
+			if (count == 0)
+				break; // only at the start, once all its edges are used
+			int next = ws->remaining[4 * current + 2 * type + rng_randint(&ws->rng, count)];
+			remove_remaining(ws, type, current, next);
+			ws->path[++len] = next;
+
+			int parity = len % 2;
+			int previous = ws->path_index[2 * next + parity];
+			if (previous < 0) {
+				ws->path_index[2 * next + parity] = len;
+				continue;
+			}
+
+			// path[previous ... len] is closed and alternating: store it
+			// starting from a node whose next edge is in A
+			if (previous % 2 == 0) {
+				for (int i = previous; i < len; i++)
+					ws->cycles[ncycle_nodes++] = ws->path[i];
+			} else {
+				for (int i = previous + 1; i <= len; i++)
+					ws->cycles[ncycle_nodes++] = ws->path[i];
+			}
+			ws->cycle_offset[++ws->ncycles] = ncycle_nodes;
+
+			for (int i = previous + 1; i < len; i++)
+				ws->path_index[2 * ws->path[i] + i % 2] = -1;
+			len = previous;
+		}
+		ws->path_index[2 * start] = -1;
+	}
+}
+
+/**
+ * Replaces the A edges of the cycle with its B edges in the child.
+ *
+ * returns the cost change
+ * */
+static double apply_ab_cycle(const struct tsp* tsp, struct eax_workspace* ws, int cycle)
+{
+	const int* nodes = ws->cycles + ws->cycle_offset[cycle];
+	int len = ws->cycle_offset[cycle + 1] - ws->cycle_offset[cycle];
+	double delta = 0;
+	for (int k = 0; k < len; k += 2) {
+		int u = nodes[k], w = nodes[k + 1];
+		adj_replace(ws->child, u, w, -1);
+		adj_replace(ws->child, w, u, -1);
+		delta -= tsp_cost(tsp, u, w);
+	}
+	for (int k = 1; k < len; k += 2) {
+		int u = nodes[k], w = nodes[k + 1 == len ? 0 : k + 1];
+		adj_replace(ws->child, u, -1, w);
+		adj_replace(ws->child, w, -1, u);
+		delta += tsp_cost(tsp, u, w);
+		local_search_push(&ws->ls, u);
+		local_search_push(&ws->ls, w);
+	}
+	return delta;
+}
+
+static inline int adj_next(const int* adj, int node, int previous)
+{
+	return adj[2 * node] != previous ? adj[2 * node] : adj[2 * node + 1];
+}
+
+/**
+ * Joins the subtours of the child, always merging the smallest one with
+ * the 2-edge exchange of minimum cost among the candidates of its nodes.
+ *
+ * returns the cost change
+ * */
+static double merge_subtours(const struct tsp* tsp, const struct candidates* cand, struct eax_workspace* ws)
+{
+	int n = ws->nnodes;
+	int* child = ws->child;
+	int nsubtours = 0;
+	for (int v = 0; v < n; v++)
+		ws->label[v] = -1;
+	for (int v = 0; v < n; v++) {
+		if (ws->label[v] >= 0)
+			continue;
+		int size = 0, previous = -1, current = v;
+		do {
+			ws->label[current] = nsubtours;
+			size++;
+			int next = adj_next(child, current, previous);
+			previous = current;
+			current = next;
+		} while (current != v);
+		ws->subtour_size[nsubtours] = size;
+		ws->subtour_node[nsubtours] = v;
+		nsubtours++;
+	}
+
+	double delta = 0;
+	for (int active = nsubtours; active > 1; active--) {
+		int smallest = -1;
+		for (int s = 0; s < nsubtours; s++) {
+			if (ws->subtour_size[s] > 0 && (smallest < 0 || ws->subtour_size[s] < ws->subtour_size[smallest]))
+				smallest = s;
+		}
+
+		int nmembers = 0, previous = -1, current = ws->subtour_node[smallest];
+		do {
+			ws->members[nmembers++] = current;
+			int next = adj_next(child, current, previous);
+			previous = current;
+			current = next;
+		} while (current != ws->subtour_node[smallest]);
+
+		// remove (u, su), (v, sv) and add (u, v), (su, sv) or (u, sv), (su, v)
+		double best = INFINITY;
+		int best_u = -1, best_su = -1, best_v = -1, best_sv = -1, best_cross = 0;
+		for (int m = 0; m < nmembers; m++) {
+			int u = ws->members[m];
+			for (int k = cand->offset[u]; k < cand->offset[u + 1]; k++) {
+				int v = cand->nodes[k];
+				if (ws->label[v] == smallest)
+					continue;
+				for (int s = 0; s < 2; s++) {
+					int su = child[2 * u + s];
+					for (int t = 0; t < 2; t++) {
+						int sv = child[2 * v + t];
+						double removed = tsp_cost(tsp, u, su) + tsp_cost(tsp, v, sv);
+						double straight = tsp_cost(tsp, u, v) + tsp_cost(tsp, su, sv) - removed;
+						double cross = tsp_cost(tsp, u, sv) + tsp_cost(tsp, su, v) - removed;
+						if (straight < best || cross < best) {
+							best = fmin(straight, cross);
+							best_u = u, best_su = su, best_v = v, best_sv = sv;
+							best_cross = cross < straight;
+						}
+					}
+				}
+			}
+		}
+		if (best_u < 0) {
+			// no candidate outside the subtour, try every node
+			int u = ws->members[0];
+			for (int v = 0; v < n; v++) {
+				if (ws->label[v] == smallest)
+					continue;
+				for (int s = 0; s < 2; s++) {
+					int su = child[2 * u + s];
+					for (int t = 0; t < 2; t++) {
+						int sv = child[2 * v + t];
+						double removed = tsp_cost(tsp, u, su) + tsp_cost(tsp, v, sv);
+						double straight = tsp_cost(tsp, u, v) + tsp_cost(tsp, su, sv) - removed;
+						double cross = tsp_cost(tsp, u, sv) + tsp_cost(tsp, su, v) - removed;
+						if (straight < best || cross < best) {
+							best = fmin(straight, cross);
+							best_u = u, best_su = su, best_v = v, best_sv = sv;
+							best_cross = cross < straight;
+						}
+					}
+				}
+			}
+		}
+
+		int u = best_u, su = best_su, v = best_v, sv = best_sv;
+		if (best_cross) {
+			int t = v;
+			v = sv;
+			sv = t;
+		}
+		// now add (u, v), (su, sv)
+		adj_replace(child, u, su, v);
+		adj_replace(child, su, u, sv);
+		adj_replace(child, v, sv, u);
+		adj_replace(child, sv, v, su);
+		delta += best;
+		local_search_push(&ws->ls, u);
+		local_search_push(&ws->ls, su);
+		local_search_push(&ws->ls, v);
+		local_search_push(&ws->ls, sv);
+
+		int merged = ws->label[v];
+		for (int m = 0; m < nmembers; m++)
+			ws->label[ws->members[m]] = merged;
+		ws->subtour_size[merged] += ws->subtour_size[smallest];
+		ws->subtour_size[smallest] = 0;
+	}
+	return delta;
+}
+
+struct genetic_context {
+	struct tsp* tsp;
+	const struct candidates* cand;
+	struct population* current;
+	struct population* next;
+	int* order; // individual i is paired with i + 1 in this order
+	int initializing;
+	int generation;
+	atomic_int next_task;
+	atomic_long children;
+};
+
+struct genetic_worker {
+	struct genetic_context* ctx;
+	struct eax_workspace* ws;
+};
+
+/**
+ * Builds an individual with greedy and local search
+ * */
+static void genetic_initialize(struct genetic_context* ctx, struct eax_workspace* ws, int individual)
+{
+	struct tsp* tsp = ctx->tsp;
+	int n = tsp->nnodes;
+	double value;
+	int* tour = population_tour(ctx->current, individual);
+	tsp_solve_greedy(tsp, rng_randint(&ws->rng, n), tour, &value);
+	for (int i = 0; i < n; i++)
+		ws->position[tour[i]] = i;
+	local_search_push_all(&ws->ls);
+	local_search_2opt(tsp, &ws->ls, tour, ws->position, &value);
+
+	ctx->current->values[individual] = value;
+	ctx->current->hashes[individual] = tourhash_compute(tour, n);
+	tsp_save_solution_shared(tsp, tour, value, 0);
+}
+
+/**
+ * Generates the children of A = order[pair], B = order[pair + 1] and
+ * stores the best one (or A) in the next population
+ * */
+static void genetic_crossover(struct genetic_context* ctx, struct eax_workspace* ws, int pair)
+{
+	struct tsp* tsp = ctx->tsp;
+	const struct population* current = ctx->current;
+	int n = tsp->nnodes;
+	int a = ctx->order[pair];
+	int b = ctx->order[pair + 1 == current->size ? 0 : pair + 1];
+	const int* tour_a = population_tour(current, a);
+
+	tour_to_adjacency(tour_a, n, ws->adj_a);
+	tour_to_adjacency(population_tour(current, b), n, ws->adj_b);
+	build_ab_cycles(ws);
+
+	// every child uses a different AB-cycle
+	int nchildren = ws->ncycles < offspring ? ws->ncycles : offspring;
+	for (int i = 0; i < ws->ncycles; i++)
+		ws->cycle_order[i] = i;
+	for (int i = 0; i < nchildren; i++) {
+		int j = i + rng_randint(&ws->rng, ws->ncycles - i);
+		int t = ws->cycle_order[i];
+		ws->cycle_order[i] = ws->cycle_order[j];
+		ws->cycle_order[j] = t;
+	}
+
+	double best_value = current->values[a];
+	uint64_t best_hash = 0;
+	int found = 0;
+	for (int c = 0; c < nchildren && !tsp_shouldstop(tsp); c++) {
+		memcpy(ws->child, ws->adj_a, sizeof(int) * 2 * n);
+		double value = current->values[a];
+		value += apply_ab_cycle(tsp, ws, ws->cycle_order[c]);
+		value += merge_subtours(tsp, ctx->cand, ws);
+
+		int previous = -1, node = 0;
+		for (int i = 0; i < n; i++) {
+			ws->solution[i] = node;
+			ws->position[node] = i;
+			int next = adj_next(ws->child, node, previous);
+			previous = node;
+			node = next;
+		}
+		local_search_2opt(tsp, &ws->ls, ws->solution, ws->position, &value);
+		atomic_fetch_add(&ctx->children, 1);
+
+		if (value < best_value - EPSILON) {
+			uint64_t hash = tourhash_compute(ws->solution, n);
+			if (population_contains(current, hash))
+				continue;
+			memcpy(ws->best_solution, ws->solution, sizeof(int) * n);
+			best_value = value;
+			best_hash = hash;
+			found = 1;
+		}
+	}
+
+	struct population* next = ctx->next;
+	if (found) {
+		memcpy(population_tour(next, a), ws->best_solution, sizeof(int) * n);
+		next->values[a] = best_value;
+		next->hashes[a] = best_hash;
+		tsp_save_solution_shared(tsp, ws->best_solution, best_value, ctx->generation);
+	} else {
+		memcpy(population_tour(next, a), tour_a, sizeof(int) * n);
+		next->values[a] = current->values[a];
+		next->hashes[a] = current->hashes[a];
+	}
+}
+
+static void* genetic_worker(void* arg)
+{
+	struct genetic_worker* worker = arg;
+	struct genetic_context* ctx = worker->ctx;
+	int ntasks = ctx->current->size;
+	int task;
+	while ((task = atomic_fetch_add(&ctx->next_task, 1)) < ntasks) {
+		if (ctx->initializing)
+			genetic_initialize(ctx, worker->ws, task);
+		else
+			genetic_crossover(ctx, worker->ws, task);
+	}
+	return NULL;
+}
+
+/**
+ * Runs one task for each individual on the worker threads
+ *
+ * returns -1 if no thread could be started
+ * */
+static int genetic_run(struct genetic_context* ctx, struct genetic_worker* workers, pthread_t* threads, int nthreads)
+{
+	atomic_store(&ctx->next_task, 0);
+	int started = 0;
+	for (; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, genetic_worker, &workers[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	return started == 0 ? -1 : 0;
+}
+
+int tsp_solve_genetic(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 8 || population_size < 2 || offspring < 1)
+		return -1;
+
+	int n = tsp->nnodes;
+	int res = 0;
+	int nthreads = tsp_getnthreads(tsp);
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+
+	struct candidates cand = {0};
+	struct population populations[2] = {0};
+	struct eax_workspace* workspaces = calloc(nthreads, sizeof(struct eax_workspace));
+	struct genetic_worker* workers = malloc(sizeof(struct genetic_worker) * nthreads);
+	pthread_t* threads = malloc(sizeof(pthread_t) * nthreads);
+	int* order = malloc(sizeof(int) * population_size);
+	int initialized = 0;
+	if (!workspaces || !workers || !threads || !order || candidates_build(tsp, GENETIC_CANDIDATES, &cand) ||
+	    population_init(&populations[0], population_size, n) ||
+	    population_init(&populations[1], population_size, n)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	struct genetic_context ctx = {
+	    .tsp = tsp,
+	    .cand = &cand,
+	    .current = &populations[0],
+	    .next = &populations[1],
+	    .order = order,
+	    .initializing = 1,
+	    .generation = 0,
+	};
+	atomic_init(&ctx.next_task, 0);
+	atomic_init(&ctx.children, 0);
+	for (; initialized < nthreads; initialized++) {
+		if (workspace_init(&workspaces[initialized], &cand, n, rng_next(&rng))) {
+			workspace_free(&workspaces[initialized]);
+			res = -1;
+			goto free_buffers;
+		}
+		workers[initialized].ctx = &ctx;
+		workers[initialized].ws = &workspaces[initialized];
+	}
+
+	tsp->solution_value = 10e30;
+	tsp_starttimer(tsp);
+
+	if (genetic_run(&ctx, workers, threads, nthreads)) {
+		res = -1;
+		goto free_buffers;
+	}
+	ctx.initializing = 0;
+
+	while (!tsp_shouldstop(tsp)) {
+		ctx.generation++;
+		for (int i = 0; i < population_size; i++)
+			order[i] = i;
+		for (int i = population_size - 1; i > 0; i--) {
+			int j = rng_randint(&rng, i + 1);
+			int t = order[i];
+			order[i] = order[j];
+			order[j] = t;
+		}
+
+		if (genetic_run(&ctx, workers, threads, nthreads)) {
+			res = -1;
+			goto free_buffers;
+		}
+		struct population* swap = ctx.current;
+		ctx.current = ctx.next;
+		ctx.next = swap;
+
+		int best = 0, worst = 0, distinct = 0;
+		for (int i = 0; i < population_size; i++) {
+			if (ctx.current->values[i] < ctx.current->values[best])
+				best = i;
+			if (ctx.current->values[i] > ctx.current->values[worst])
+				worst = i;
+			int duplicate = 0;
+			for (int j = 0; j < i && !duplicate; j++)
+				duplicate = ctx.current->hashes[j] == ctx.current->hashes[i];
+			distinct += !duplicate;
+		}
+		eventlog_logdouble("population_best", ctx.generation, ctx.current->values[best]);
+		eventlog_logdouble("population_worst", ctx.generation, ctx.current->values[worst]);
+		eventlog_logdouble("population_distinct", ctx.generation, distinct);
+
+		// the crossover of two equal tours has no AB-cycles
+		if (distinct < 2)
+			break;
+	}
+
+	double elapsed = tsp_getelapsedseconds(tsp);
+	long children = atomic_load(&ctx.children);
+	fprintf(stderr, "Generations: %d, children: %ld in %lf s (%lf/s) with %d threads\n", ctx.generation,
+		children, elapsed, elapsed > 0 ? children / elapsed : 0, nthreads);
+
+free_buffers:
+	for (int i = 0; i < initialized; i++)
+		workspace_free(&workspaces[i]);
+	population_free(&populations[0]);
+	population_free(&populations[1]);
+	candidates_free(&cand);
+	free(order);
+	free(threads);
+	free(workers);
+	free(workspaces);
+	return res;
+}
@@ -0,0 +1,31 @@
+#ifndef TSP_GENETIC_H_
+#define TSP_GENETIC_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with a genetic algorithm based on the edge assembly
+ * crossover (EAX).
+ *
+ * Every generation pairs each individual A with another one B, and
+ * builds children from A by replacing the A edges of one AB-cycle (edges
+ * alternating between A and B) with its B edges, merging the resulting
+ * subtours greedily and applying 2opt/Or-opt around the changed edges.
+ * The best child replaces A if it is better and not already in the
+ * population.
+ *
+ * The pairs of a generation are processed by tsp_getnthreads() threads.
+ * */
+int tsp_solve_genetic(struct tsp* tsp);
+
+/**
+ * Set the number of individuals
+ * */
+void genetic_setpopulation(int size);
+
+/**
+ * Set the number of children generated from each pair of parents
+ * */
+void genetic_setoffspring(int count);
+
+#endif // TSP_GENETIC_H_
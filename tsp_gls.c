@@ -0,0 +1,119 @@
+#include "tsp_gls.h"
+#include "eventlog.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLS_CANDIDATES 10
+
+double gls_alpha = 0.3;
+
+void gls_setalpha(double alpha)
+{
+	gls_alpha = alpha;
+}
+
+static inline double utility(const struct tsp* tsp, const struct penalty_map* penalties, int a, int b)
+{
+	return tsp->cost_matrix[flatten_coords(a, b, tsp->nnodes)] / (1 + penalty_map_get(penalties, a, b));
+}
+
+int tsp_solve_gls(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 8)
+		return -1;
+
+	int n = tsp->nnodes;
+	int starting_node = rand() % n;
+	fprintf(stderr, "starting from node %d\n", starting_node);
+	tsp_solve_greedy(tsp, starting_node, tsp->solution_permutation, &tsp->solution_value);
+
+	int res = 0;
+	int* current_solution = malloc(n * sizeof(int));
+	int* position = malloc(n * sizeof(int));
+	double augmented_value = tsp->solution_value;
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	struct penalty_map penalties = {0};
+	if (!current_solution || !position || candidates_build(tsp, GLS_CANDIDATES, &cand) ||
+	    local_search_init(&ls, &cand) || penalty_map_init(&penalties, n)) {
+		res = -1;
+		goto free_buffers;
+	}
+	ls.oropt = 1;
+
+	memcpy(current_solution, tsp->solution_permutation, sizeof(int) * n);
+	for (int i = 0; i < n; i++)
+		position[current_solution[i]] = i;
+	eventlog_logdouble("new_current", 0, tsp->solution_value);
+	tsp_log_incumbent(tsp, 0, tsp->solution_value);
+
+	tsp_starttimer(tsp);
+
+	local_search_push_all(&ls);
+	int iteration = 0;
+	long penalized = 0;
+	while (1) {
+		iteration++;
+		local_search_2opt(tsp, &ls, current_solution, position, &augmented_value);
+
+		// the local search only knows the augmented cost
+		double value = 0;
+		double max_utility = 0;
+		for (int i = 0; i < n; i++) {
+			int a = current_solution[i], b = current_solution[i + 1 == n ? 0 : i + 1];
+			value += tsp->cost_matrix[flatten_coords(a, b, n)];
+			double u = utility(tsp, &penalties, a, b);
+			if (u > max_utility)
+				max_utility = u;
+		}
+		eventlog_logdouble("new_current", iteration, value);
+		if (value < tsp->solution_value - EPSILON) {
+			tsp_save_solution(tsp, current_solution, value);
+			tsp_log_incumbent(tsp, iteration, value);
+		}
+
+		if (tsp_shouldstop(tsp))
+			break;
+
+		if (!ls.penalties) {
+			ls.penalties = &penalties;
+			ls.lambda = gls_alpha * value / n;
+		}
+
+		for (int i = 0; i < n; i++) {
+			int a = current_solution[i], b = current_solution[i + 1 == n ? 0 : i + 1];
+			if (utility(tsp, &penalties, a, b) < max_utility - EPSILON)
+				continue;
+			if (penalty_map_increment(&penalties, a, b)) {
+				res = -1;
+				goto free_buffers;
+			}
+			penalized++;
+			local_search_push(&ls, a);
+			local_search_push(&ls, b);
+		}
+	}
+
+	double elapsed = tsp_getelapsedseconds(tsp);
+	fprintf(stderr, "Local optima: %d in %lf s (%lf/s), %ld penalties on %d edges\n", iteration, elapsed,
+		elapsed > 0 ? iteration / elapsed : 0, penalized, penalties.size);
+
+free_buffers:
+	penalty_map_free(&penalties);
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
+	free(current_solution);
+	return res;
+}
@@ -0,0 +1,22 @@
+#ifndef TSP_GLS_H_
+#define TSP_GLS_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with guided local search.
+ *
+ * At each local optimum the edges of the tour with the highest utility
+ * cost / (1 + penalty) are penalized, and the 2opt/Or-opt local search
+ * goes on with cost + lambda * penalty, starting only from the endpoints
+ * of the penalized edges. lambda is alpha times the average edge cost of
+ * the first local optimum.
+ * */
+int tsp_solve_gls(struct tsp* tsp);
+
+/**
+ * Set the weight of the penalties relative to the average edge cost
+ * */
+void gls_setalpha(double alpha);
+
+#endif // TSP_GLS_H_
@@ -0,0 +1,183 @@
+#include "tsp_gpx.h"
+#include "tsp.h"
+#include <stdlib.h>
+#include <string.h>
+
+int gpx_workspace_init(struct gpx_workspace* ws, int nnodes)
+{
+	ws->nnodes = nnodes;
+	ws->adj1 = malloc(sizeof(int) * 2 * nnodes);
+	ws->adj2 = malloc(sizeof(int) * 2 * nnodes);
+	ws->component = malloc(sizeof(int) * nnodes);
+	ws->stack = malloc(sizeof(int) * nnodes);
+	ws->crossings = malloc(sizeof(int) * nnodes);
+	ws->cost1 = malloc(sizeof(double) * nnodes);
+	ws->cost2 = malloc(sizeof(double) * nnodes);
+	ws->from2 = malloc(sizeof(char) * nnodes);
+	ws->visited = malloc(sizeof(char) * nnodes);
+	if (!ws->adj1 || !ws->adj2 || !ws->component || !ws->stack || !ws->crossings || !ws->cost1 || !ws->cost2 ||
+	    !ws->from2 || !ws->visited) {
+		gpx_workspace_free(ws);
+		return -1;
+	}
+	return 0;
+}
+
+void gpx_workspace_free(struct gpx_workspace* ws)
+{
+	free(ws->adj1);
+	free(ws->adj2);
+	free(ws->component);
+	free(ws->stack);
+	free(ws->crossings);
+	free(ws->cost1);
+	free(ws->cost2);
+	free(ws->from2);
+	free(ws->visited);
+	memset(ws, 0, sizeof(struct gpx_workspace));
+}
+
+void tour_to_adjacency(const int* tour, int n, int* adj)
+{
+	for (int i = 0; i < n; i++) {
+		adj[2 * tour[i]] = tour[i == 0 ? n - 1 : i - 1];
+		adj[2 * tour[i] + 1] = tour[i + 1 == n ? 0 : i + 1];
+	}
+}
+
+static inline int is_shared_node(const struct gpx_workspace* ws, int u)
+{
+	return adjacency_has_edge(ws->adj2, u, ws->adj1[2 * u]) && adjacency_has_edge(ws->adj2, u, ws->adj1[2 * u + 1]);
+}
+
+/**
+ * Builds the child tour from the adjacency of each node.
+ *
+ * returns -1 if it is not a single cycle
+ * */
+static int adjacency_to_tour(struct gpx_workspace* ws, int* child)
+{
+	int n = ws->nnodes;
+	memset(ws->visited, 0, n);
+	int previous = -1, node = 0;
+	for (int i = 0; i < n; i++) {
+		if (ws->visited[node])
+			return -1;
+		ws->visited[node] = 1;
+		child[i] = node;
+		int c = ws->component[node];
+		const int* adj = c >= 0 && ws->from2[c] ? ws->adj2 : ws->adj1;
+		int next = adj[2 * node] != previous ? adj[2 * node] : adj[2 * node + 1];
+		previous = node;
+		node = next;
+	}
+	return node == 0 ? 0 : -1;
+}
+
+int tsp_gpx(struct gpx_workspace* ws,
+	    const struct tsp* tsp,
+	    const int* parent1,
+	    double value1,
+	    const int* parent2,
+	    double value2,
+	    int* child,
+	    double* child_value)
+{
+	int n = tsp->nnodes;
+	if (ws->nnodes != n)
+		return -1;
+
+	tour_to_adjacency(parent1, n, ws->adj1);
+	tour_to_adjacency(parent2, n, ws->adj2);
+
+	// components of the graph of the edges in only one of the parents. Nodes
+	// with only shared edges are left out (component -1)
+	int ncomponents = 0;
+	for (int v = 0; v < n; v++)
+		ws->component[v] = -1;
+	for (int v = 0; v < n; v++) {
+		if (ws->component[v] >= 0 || is_shared_node(ws, v))
+			continue;
+		int size = 0;
+		ws->stack[size++] = v;
+		ws->component[v] = ncomponents;
+		ws->crossings[ncomponents] = 0;
+		ws->cost1[ncomponents] = 0;
+		ws->cost2[ncomponents] = 0;
+		while (size > 0) {
+			int u = ws->stack[--size];
+			for (int k = 0; k < 4; k++) {
+				const int* adj = k < 2 ? ws->adj1 : ws->adj2;
+				const int* other = k < 2 ? ws->adj2 : ws->adj1;
+				int w = adj[2 * u + k % 2];
+				if (adjacency_has_edge(other, u, w) || ws->component[w] >= 0)
+					continue;
+				ws->component[w] = ncomponents;
+				ws->stack[size++] = w;
+			}
+		}
+		ncomponents++;
+	}
+
+	// a path of shared edges leaving a component crosses to another one
+	// only if it ends in another component: paths coming back (a segment
+	// reversed by the other parent) are internal. The cost of the edges of
+	// each parent inside a component is counted from both endpoints
+	for (int u = 0; u < n; u++) {
+		int c = ws->component[u];
+		if (c < 0)
+			continue;
+		for (int k = 0; k < 2; k++) {
+			int w = ws->adj1[2 * u + k];
+			if (adjacency_has_edge(ws->adj2, u, w)) {
+				int previous = u;
+				while (ws->component[w] < 0) {
+					int next = ws->adj1[2 * w] != previous ? ws->adj1[2 * w] : ws->adj1[2 * w + 1];
+					previous = w;
+					w = next;
+				}
+				if (ws->component[w] != c)
+					ws->crossings[c]++;
+			} else {
+				ws->cost1[c] += tsp->cost_matrix[flatten_coords(u, w, n)];
+			}
+			w = ws->adj2[2 * u + k];
+			if (!adjacency_has_edge(ws->adj1, u, w))
+				ws->cost2[c] += tsp->cost_matrix[flatten_coords(u, w, n)];
+		}
+	}
+
+	// the components that can't be chosen independently all come from the
+	// parent that is cheaper on them
+	double infeasible1 = 0, infeasible2 = 0;
+	for (int c = 0; c < ncomponents; c++) {
+		if (ws->crossings[c] != 2) {
+			infeasible1 += ws->cost1[c];
+			infeasible2 += ws->cost2[c];
+		}
+	}
+	int base2 = infeasible2 < infeasible1;
+
+	int partitions = 0;
+	double delta = 0; // with respect to parent 1, costs are counted twice
+	for (int c = 0; c < ncomponents; c++) {
+		if (ws->crossings[c] == 2) {
+			ws->from2[c] = ws->cost2[c] < ws->cost1[c];
+			if (ws->cost1[c] != ws->cost2[c])
+				partitions++;
+		} else {
+			ws->from2[c] = base2;
+		}
+		if (ws->from2[c])
+			delta += ws->cost2[c] - ws->cost1[c];
+	}
+
+	if (adjacency_to_tour(ws, child)) {
+		// shouldn't happen, keep the better parent
+		memcpy(child, value2 < value1 ? parent2 : parent1, sizeof(int) * n);
+		*child_value = value2 < value1 ? value2 : value1;
+		return 0;
+	}
+	*child_value = value1 + delta / 2;
+	return partitions;
+}
@@ -0,0 +1,62 @@
+#ifndef TSP_GPX_H_
+#define TSP_GPX_H_
+
+#include "tsp.h"
+
+/**
+ * Fills adj[2 * v] and adj[2 * v + 1] with the two neighbours of v in the
+ * tour
+ * */
+void tour_to_adjacency(const int* tour, int n, int* adj);
+
+static inline int adjacency_has_edge(const int* adj, int u, int v)
+{
+	return adj[2 * u] == v || adj[2 * u + 1] == v;
+}
+
+/**
+ * Buffers of the partition crossover, one for each thread
+ * */
+struct gpx_workspace {
+	int nnodes;
+	int* adj1;
+	int* adj2;
+	int* component;
+	int* stack;
+	int* crossings;
+	double* cost1;
+	double* cost2;
+	char* from2;
+	char* visited;
+};
+
+int gpx_workspace_init(struct gpx_workspace* ws, int nnodes);
+
+void gpx_workspace_free(struct gpx_workspace* ws);
+
+/**
+ * Partition crossover (GPX) in O(n).
+ *
+ * Removing the edges shared by the parents splits the nodes into
+ * components. Paths of shared edges going back to the component they
+ * leave are contracted. A component entered only twice by the shared
+ * paths is visited by both parents with a single path between the same
+ * two nodes, so the cheaper of the two paths can be taken independently
+ * of the other components. The remaining components are all taken from the
+ * parent that is cheaper on them.
+ *
+ * The child is never worse than the better parent.
+ *
+ * returns the number of components in which the parents differ and that
+ * could be chosen independently, -1 on error
+ * */
+int tsp_gpx(struct gpx_workspace* ws,
+	    const struct tsp* tsp,
+	    const int* parent1,
+	    double value1,
+	    const int* parent2,
+	    double value2,
+	    int* child,
+	    double* child_value);
+
+#endif // TSP_GPX_H_
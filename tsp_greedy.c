@@ -1,17 +1,129 @@
 #include "tsp_greedy.h"
 #include "eventlog.h"
 #include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_delaunay.h"
+#include "tsp_localsearch.h"
 #include "tsp_tabu.h"
+#include "tourhash.h"
+#include "tsp_gpx.h"
 #include "util.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static int multistart(struct tsp* tsp, tsp_constructor constructor, int use2opt, int prune);
+
+int use_gpx = 0;
+
+void multistart_setgpx(int gpx)
+{
+	use_gpx = gpx;
+}
+
 /**
  * Output buffers have to be preallocated
  * */
 int tsp_solve_greedy(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	return tsp_solve_greedy_bounded(tsp, starting_node, NULL, 10e30, output_solution, output_value);
+}
+
+int tsp_greedy_bound_init(const struct tsp* tsp, struct tsp_greedy_bound* bound, int k)
+{
+	if (tsp->nnodes < 3 || candidates_build_nearest(tsp, k, &bound->cand))
+		return -1;
+
+	const struct candidates* cand = &bound->cand;
+	bound->costs = malloc(sizeof(double) * cand->offset[tsp->nnodes]);
+	if (!bound->costs) {
+		candidates_free(&bound->cand);
+		return -1;
+	}
+	for (int i = 0; i < tsp->nnodes; i++) {
+		for (int c = cand->offset[i]; c < cand->offset[i + 1]; c++)
+			bound->costs[c] = tsp_cost(tsp, i, cand->nodes[c]);
+	}
+	return 0;
+}
+
+void tsp_greedy_bound_free(struct tsp_greedy_bound* bound)
+{
+	candidates_free(&bound->cand);
+	free(bound->costs);
+	bound->costs = NULL;
+}
+
+/**
+ * Index of the first neighbour of node, starting from position,
+ * that is still unvisited or is the starting node
+ * */
+static int bound_nextallowed(const struct tsp_greedy_bound* bound,
+			     int node,
+			     int position,
+			     const char* visited,
+			     int starting_node)
+{
+	const int* neighbours = bound->cand.nodes + bound->cand.offset[node];
+	int k = bound->cand.offset[node + 1] - bound->cand.offset[node];
+	while (position < k && visited[neighbours[position]] && neighbours[position] != starting_node)
+		position++;
+	return position;
+}
+
+/**
+ * Lower bound on the cost of a path from current to starting_node visiting
+ * all the nodes in current_solution[i + 1 ... nnodes - 1].
+ *
+ * Each of those nodes needs two edges towards the unvisited nodes, current
+ * or starting_node: half the cost of its two cheapest such edges is summed.
+ * Neighbours beyond the candidate list cost at least as the last one.
+ * */
+static double bound_remaining(const struct tsp* tsp,
+			      const struct tsp_greedy_bound* bound,
+			      const int* current_solution,
+			      int i,
+			      int* first,
+			      const char* visited)
+{
+	int current = current_solution[i];
+	int starting_node = current_solution[0];
+	double remaining = 0;
+	for (int j = i + 1; j < tsp->nnodes; j++) {
+		int v = current_solution[j];
+		const double* costs = bound->costs + bound->cand.offset[v];
+		int k = bound->cand.offset[v + 1] - bound->cand.offset[v];
+		double last = costs[k - 1];
+
+		first[v] = bound_nextallowed(bound, v, first[v], visited, starting_node);
+		int second = bound_nextallowed(bound, v, first[v] + 1, visited, starting_node);
+		double m1 = first[v] < k ? costs[first[v]] : last;
+		double m2 = second < k ? costs[second] : last;
+		double d = tsp->cost_matrix[flatten_coords(current, v, tsp->nnodes)];
+
+		// m1 <= m2: keep the two cheapest among m1, m2, d
+		if (d < m2)
+			m2 = d;
+		remaining += (m1 + m2) / 2;
+	}
+	return remaining;
+}
+
+int tsp_solve_greedy_bounded(struct tsp* tsp,
+			     int starting_node,
+			     const struct tsp_greedy_bound* bound,
+			     double cutoff,
+			     int* output_solution,
+			     double* output_value)
 {
 	if (starting_node < 0 || starting_node >= tsp->nnodes)
 		return -1;
@@ -29,6 +141,16 @@ int tsp_solve_greedy(struct tsp* tsp, int starting_node, int* output_solution, d
 
 	double cumulative_dist = 0;
 
+	// the bound is refreshed only every few steps, its cost is O(n)
+	int check_every = tsp->nnodes / 64 + 1;
+	int* first = NULL;
+	char* visited = NULL;
+	if (bound) {
+		first = calloc(tsp->nnodes, sizeof(int));
+		visited = calloc(tsp->nnodes, sizeof(char));
+		visited[starting_node] = 1;
+	}
+
 	for (int i = 0; i < tsp->nnodes - 1; i++) {
 		double min_dist = 1e30;
 		int min_index = -1;
@@ -47,6 +169,18 @@ int tsp_solve_greedy(struct tsp* tsp, int starting_node, int* output_solution, d
 		current_solution[min_index] = temp;
 
 		cumulative_dist += min_dist;
+
+		if (bound) {
+			visited[current_solution[i + 1]] = 1;
+			if ((i + 1) % check_every == 0 &&
+			    cumulative_dist + bound_remaining(tsp, bound, current_solution, i + 1, first, visited) >
+				cutoff + EPSILON) {
+				free(visited);
+				free(first);
+				free(current_solution);
+				return 1;
+			}
+		}
 	}
 
 	double backarc = tsp->cost_matrix[flatten_coords(current_solution[tsp->nnodes - 1], current_solution[0],
@@ -57,76 +191,600 @@ int tsp_solve_greedy(struct tsp* tsp, int starting_node, int* output_solution, d
 	memcpy(output_solution, current_solution, sizeof(int) * tsp->nnodes);
 	*output_value = cumulative_dist;
 
+	free(visited);
+	free(first);
 	free(current_solution);
 	return 0;
 }
 
-int tsp_solve_multigreedy(struct tsp* tsp, int use2opt)
+/**
+ * Returns the position j in nodes[0 ... size - 1] minimizing row[nodes[j]].
+ * Ties are broken by the lowest position.
+ *
+ * The minimum is computed first with independent SIMD accumulators (no
+ * index tracking in the hot loop), then its first position is searched.
+ * The AVX2 gathers need -march=native (see the Makefile), the default
+ * build takes the SSE2 path, which still loads the costs one by one.
+ * Contiguous loads over the whole row, with the visited columns masked,
+ * were slower: the scan is bound by the memory traffic on the row.
+ * */
+static int greedy_argmin(const double* row, const int* nodes, int size, double* min_dist)
 {
-	if (tsp_allocate_solution(tsp))
+	double best = 1e30;
+	int j = 0;
+
+#if defined(__AVX2__)
+	__m256d acc0 = _mm256_set1_pd(1e30);
+	__m256d acc1 = acc0, acc2 = acc0, acc3 = acc0;
+	for (; j + 16 <= size; j += 16) {
+		const __m128i* index = (const __m128i*)(nodes + j);
+		acc0 = _mm256_min_pd(acc0, _mm256_i32gather_pd(row, _mm_loadu_si128(index), sizeof(double)));
+		acc1 = _mm256_min_pd(acc1, _mm256_i32gather_pd(row, _mm_loadu_si128(index + 1), sizeof(double)));
+		acc2 = _mm256_min_pd(acc2, _mm256_i32gather_pd(row, _mm_loadu_si128(index + 2), sizeof(double)));
+		acc3 = _mm256_min_pd(acc3, _mm256_i32gather_pd(row, _mm_loadu_si128(index + 3), sizeof(double)));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_min_pd(_mm256_min_pd(acc0, acc1), _mm256_min_pd(acc2, acc3)));
+	for (int l = 0; l < 4; l++) {
+		if (lanes[l] < best)
+			best = lanes[l];
+	}
+#elif defined(__SSE2__)
+	__m128d acc0 = _mm_set1_pd(1e30);
+	__m128d acc1 = acc0;
+	for (; j + 4 <= size; j += 4) {
+		acc0 = _mm_min_pd(acc0, _mm_set_pd(row[nodes[j + 1]], row[nodes[j]]));
+		acc1 = _mm_min_pd(acc1, _mm_set_pd(row[nodes[j + 3]], row[nodes[j + 2]]));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_min_pd(acc0, acc1));
+	for (int l = 0; l < 2; l++) {
+		if (lanes[l] < best)
+			best = lanes[l];
+	}
+#endif
+
+	for (; j < size; j++) {
+		if (row[nodes[j]] < best)
+			best = row[nodes[j]];
+	}
+
+	int best_j = 0;
+	while (best_j < size - 1 && row[nodes[best_j]] != best)
+		best_j++;
+
+	*min_dist = best;
+	return best_j;
+}
+
+int tsp_solve_greedy_dense(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	if (starting_node < 0 || starting_node >= tsp->nnodes)
 		return -1;
 
-	if (!tsp->cost_matrix)
+	if (output_solution == NULL || output_value == NULL)
 		return -1;
 
-	if (!tsp->nnodes)
+	int n = tsp->nnodes;
+	// unvisited nodes, compacted and kept in increasing order
+	int* unvisited = malloc(sizeof(int) * n);
+	int size = 0;
+	for (int i = 0; i < n; i++) {
+		if (i != starting_node)
+			unvisited[size++] = i;
+	}
+
+	double cumulative_dist = 0;
+	int current = starting_node;
+	output_solution[0] = starting_node;
+
+	for (int i = 1; i < n; i++) {
+		double min_dist;
+		const double* row = tsp->cost_matrix + (size_t)current * n;
+		int j = greedy_argmin(row, unvisited, size, &min_dist);
+
+		current = unvisited[j];
+		memmove(unvisited + j, unvisited + j + 1, sizeof(int) * (size - j - 1));
+		size--;
+
+		output_solution[i] = current;
+		cumulative_dist += min_dist;
+	}
+
+	cumulative_dist += tsp->cost_matrix[flatten_coords(current, starting_node, n)];
+	*output_value = cumulative_dist;
+
+	free(unvisited);
+	return 0;
+}
+
+// candidates per node of the greedy edge construction and of the local
+// search after a single start
+#define GREEDY_CANDIDATES 10
+
+struct greedy_edge {
+	double cost;
+	int a;
+	int b;
+};
+
+static int compar_greedy_edges(const void* x, const void* y)
+{
+	const struct greedy_edge* e = x;
+	const struct greedy_edge* f = y;
+	if (e->cost != f->cost)
+		return e->cost < f->cost ? -1 : 1;
+	if (e->a != f->a)
+		return e->a - f->a;
+	return e->b - f->b;
+}
+
+/**
+ * Add the edges by increasing cost when both ends have degree less than 2
+ * and no cycle is closed. The fragments are paths, other_end[i] is the
+ * other end of the fragment of i if i is an end.
+ *
+ * returns the number of added edges
+ * */
+static int greedy_edge_pass(struct greedy_edge* edges, int nedges, int* adjacent, int* degree, int* other_end)
+{
+	qsort(edges, nedges, sizeof(struct greedy_edge), compar_greedy_edges);
+	int added = 0;
+	for (int e = 0; e < nedges; e++) {
+		int a = edges[e].a, b = edges[e].b;
+		if (degree[a] == 2 || degree[b] == 2 || other_end[a] == b)
+			continue;
+		adjacent[2 * a + degree[a]++] = b;
+		adjacent[2 * b + degree[b]++] = a;
+		int end_a = other_end[a], end_b = other_end[b];
+		other_end[end_a] = end_b;
+		other_end[end_b] = end_a;
+		added++;
+	}
+	return added;
+}
+
+static void greedy_edge_set(const struct tsp* tsp, struct greedy_edge* edge, int i, int j)
+{
+	edge->cost = tsp_cost(tsp, i, j);
+	edge->a = i < j ? i : j;
+	edge->b = i < j ? j : i;
+}
+
+int tsp_solve_greedy_edge(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	int n = tsp->nnodes;
+	if (n < 3)
 		return -1;
 
-	tsp->solution_value = 10e30;
-	int* current_solution = malloc(sizeof(int) * tsp->nnodes);
-	double current_solution_value = 10e30;
+	int res = 0;
+	struct candidates cand = {0};
+	struct greedy_edge* edges = NULL;
+	int* adjacent = malloc(sizeof(int) * 2 * n);
+	int* degree = calloc(n, sizeof(int));
+	int* other_end = malloc(sizeof(int) * n);
+	int* ends = malloc(sizeof(int) * n);
+	int* from = malloc(sizeof(int) * 3 * n);
+	int* to = malloc(sizeof(int) * 3 * n);
+	if (!adjacent || !degree || !other_end || !ends || !from || !to ||
+	    candidates_build(tsp, GREEDY_CANDIDATES, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+	int capacity = cand.offset[n] > 3 * n ? cand.offset[n] : 3 * n;
+	edges = malloc(sizeof(struct greedy_edge) * capacity);
+	if (!edges) {
+		res = -1;
+		goto free_buffers;
+	}
 
-	int* to_extract = malloc(sizeof(int) * tsp->nnodes);
-	for (int i = 0; i < tsp->nnodes; i++) {
-		to_extract[i] = i;
+	// an edge in both lists is seen twice, the second time it closes a cycle
+	int nedges = 0;
+	for (int i = 0; i < n; i++) {
+		for (int k = cand.offset[i]; k < cand.offset[i + 1]; k++)
+			greedy_edge_set(tsp, &edges[nedges++], i, cand.nodes[k]);
 	}
-	int t = 0;
-	int current_iteration = 0;
+	for (int i = 0; i < n; i++)
+		other_end[i] = i;
+	int fragments = n - greedy_edge_pass(edges, nedges, adjacent, degree, other_end);
 
-	tsp_starttimer(tsp);
+	// the fragments are joined by greedy passes on the Delaunay
+	// triangulation of their ends, each pass adds at least one edge
+	while (fragments > 1) {
+		int nends = 0;
+		for (int i = 0; i < n; i++) {
+			if (degree[i] < 2)
+				ends[nends++] = i;
+		}
+		nedges = delaunay_edges(tsp, ends, nends, from, to);
+		if (nedges < 0) {
+			res = -1;
+			goto free_buffers;
+		}
+		for (int e = 0; e < nedges; e++)
+			greedy_edge_set(tsp, &edges[e], from[e], to[e]);
+		int added = greedy_edge_pass(edges, nedges, adjacent, degree, other_end);
+		if (!added) {
+			res = -1;
+			goto free_buffers;
+		}
+		fragments -= added;
+	}
 
-	for (int i = 0; i < tsp->nnodes; i++) {
-		// compute starting node
-		int r = rand() % (tsp->nnodes - t);
-		int starting_node = to_extract[r];
-		to_extract[r] = to_extract[tsp->nnodes - t - 1];
-		to_extract[tsp->nnodes - t - 1] = starting_node;
-		t++;
+	// close the last fragment
+	int first = 0;
+	while (degree[first] == 2)
+		first++;
+	int last = other_end[first];
+	adjacent[2 * first + degree[first]++] = last;
+	adjacent[2 * last + degree[last]++] = first;
+
+	// walk the cycle from the starting node
+	*output_value = 0;
+	int previous = -1;
+	int current = starting_node;
+	for (int i = 0; i < n; i++) {
+		output_solution[i] = current;
+		int next = adjacent[2 * current] != previous ? adjacent[2 * current] : adjacent[2 * current + 1];
+		*output_value += tsp_cost(tsp, current, next);
+		previous = current;
+		current = next;
+	}
+
+free_buffers:
+	free(edges);
+	candidates_free(&cand);
+	free(to);
+	free(from);
+	free(ends);
+	free(other_end);
+	free(degree);
+	free(adjacent);
+	return res;
+}
+
+int tsp_solve_multigreedy(struct tsp* tsp, int use2opt)
+{
+	return tsp_solve_multistart(tsp, tsp_solve_greedy, use2opt);
+}
+
+int tsp_solve_multigreedy_pruned(struct tsp* tsp, int use2opt)
+{
+	return multistart(tsp, tsp_solve_greedy, use2opt, 1);
+}
+
+int tsp_solve_multistart(struct tsp* tsp, tsp_constructor constructor, int use2opt)
+{
+	return multistart(tsp, constructor, use2opt, 0);
+}
+
+struct multistart_context {
+	struct tsp* tsp;
+	tsp_constructor constructor;
+	int use2opt;
+	const struct tsp_greedy_bound* bound; // NULL if starts are not pruned
+	// with 2opt the starts are pruned against the best greedy tour, as a
+	// worse one can still lead to a better local optimum than the incumbent
+	_Atomic double best_greedy;
+
+	const int* start_order;
+	atomic_int next_start;
+	atomic_int iteration; // time instant shared by all the workers in the eventlog
+
+	// 2opt is deterministic: a tour already seen during a descent leads to
+	// a local optimum that is already known
+	pthread_mutex_t seen_lock;
+	struct hashset seen_tours;
+	struct hashset seen_optima;
+
+	atomic_int starts;
+	atomic_int pruned;
+	atomic_int duplicates;
+	atomic_int merged;
+	atomic_int gpx_improvements;
+	atomic_int failed;
+};
+
+/**
+ * returns the new size of the set if the hash was not in the set, 0 otherwise,
+ * -1 on error
+ * */
+static int multistart_seen_insert(struct multistart_context* ctx, struct hashset* set, uint64_t hash)
+{
+	pthread_mutex_lock(&ctx->seen_lock);
+	int res = hashset_insert(set, hash);
+	if (res > 0)
+		res = set->size;
+	pthread_mutex_unlock(&ctx->seen_lock);
+	return res;
+}
+
+static void* multistart_worker(void* arg)
+{
+	struct multistart_context* ctx = arg;
+	struct tsp* tsp = ctx->tsp;
+
+	int* current_solution = malloc(sizeof(int) * tsp->nnodes);
+	double current_solution_value;
+
+	// partition crossover between each new local optimum and the incumbent
+	int* incumbent = NULL;
+	int* child = NULL;
+	struct gpx_workspace gpx = {0};
+	if (ctx->use2opt && use_gpx) {
+		incumbent = malloc(sizeof(int) * tsp->nnodes);
+		child = malloc(sizeof(int) * tsp->nnodes);
+		if (!incumbent || !child || gpx_workspace_init(&gpx, tsp->nnodes)) {
+			atomic_store(&ctx->failed, 1);
+			goto free_worker_buffers;
+		}
+	}
+
+	while (1) {
+		if (tsp_shouldstop(tsp))
+			break;
+		int k = atomic_fetch_add(&ctx->next_start, 1);
+		if (k >= tsp->nnodes)
+			break;
+		int starting_node = ctx->start_order[k];
+		atomic_fetch_add(&ctx->starts, 1);
 #ifdef DEBUG
 		fprintf(stderr, "Starting node %d/%d\n", starting_node + 1, tsp->nnodes);
 #endif
+		int current_iteration = atomic_load(&ctx->iteration);
 
-		if (tsp_solve_greedy(tsp, starting_node, current_solution, &current_solution_value)) {
-			fprintf(stderr, "Can't solve greedy!\n");
-			return -1;
+		int res;
+		if (ctx->bound) {
+			double cutoff = ctx->use2opt ? atomic_load(&ctx->best_greedy) : tsp_get_solution_value(tsp);
+			res = tsp_solve_greedy_bounded(tsp, starting_node, ctx->bound, cutoff, current_solution,
+						       &current_solution_value);
+		} else {
+			res = ctx->constructor(tsp, starting_node, current_solution, &current_solution_value);
 		}
-		if (current_solution_value < tsp->solution_value) {
-			tsp_save_solution(tsp, current_solution, current_solution_value);
-			eventlog_logdouble("new_incumbent", current_iteration, current_solution_value);
+		if (res == 1) {
+			int pruned = atomic_fetch_add(&ctx->pruned, 1) + 1;
+			eventlog_logdouble("pruned", current_iteration, pruned);
+			continue;
 		}
+		if (res) {
+			fprintf(stderr, "Can't solve greedy!\n");
+			atomic_store(&ctx->failed, 1);
+			break;
+		}
+
+		double best_greedy = atomic_load(&ctx->best_greedy);
+		while (current_solution_value < best_greedy &&
+		       !atomic_compare_exchange_weak(&ctx->best_greedy, &best_greedy, current_solution_value))
+			;
+		tsp_save_solution_shared(tsp, current_solution, current_solution_value, current_iteration);
 		eventlog_logdouble("new_current", current_iteration, current_solution_value);
-		if (use2opt) {
-			while (1) {
-				if (tsp_shouldstop(tsp))
-					goto free_solution_buffers;
-				current_iteration++;
-				int best_i, best_j;
-				double best_delta = tsp_2opt_findbestswap(tsp, current_solution, &best_i, &best_j);
-				if (best_delta <= 0)
-					break;
-				int isnewbest = tsp_2opt_swap_save(tsp, current_solution, &current_solution_value,
-								   best_i, best_j, best_delta);
-				if (isnewbest)
-					eventlog_logdouble("new_incumbent", current_iteration, current_solution_value);
-				eventlog_logdouble("new_current", current_iteration, current_solution_value);
+		if (!ctx->use2opt)
+			continue;
+
+		uint64_t hash = tourhash_compute(current_solution, tsp->nnodes);
+		int seen = multistart_seen_insert(ctx, &ctx->seen_tours, hash);
+		if (seen < 0) {
+			atomic_store(&ctx->failed, 1);
+			break;
+		}
+		if (!seen) {
+			atomic_fetch_add(&ctx->duplicates, 1);
+			continue;
+		}
+		int is_merged = 0;
+		while (1) {
+			if (tsp_shouldstop(tsp))
+				goto free_worker_buffers;
+			current_iteration = atomic_fetch_add(&ctx->iteration, 1) + 1;
+			int best_i, best_j;
+			double best_delta = tsp_2opt_findbestswap(tsp, current_solution, &best_i, &best_j);
+			if (best_delta <= 0)
+				break;
+			hash += tourhash_2opt_delta(current_solution, tsp->nnodes, best_i, best_j);
+			tsp_2opt_swap(best_i + 1, best_j, current_solution);
+			current_solution_value -= best_delta;
+			tsp_save_solution_shared(tsp, current_solution, current_solution_value, current_iteration);
+			eventlog_logdouble("new_current", current_iteration, current_solution_value);
+			seen = multistart_seen_insert(ctx, &ctx->seen_tours, hash);
+			if (seen < 0) {
+				atomic_store(&ctx->failed, 1);
+				goto free_worker_buffers;
+			}
+			if (!seen) {
+				// joined the descent of a previous start
+				atomic_fetch_add(&ctx->merged, 1);
+				is_merged = 1;
+				break;
 			}
 		}
-	}
+		int unique_optima = is_merged ? 0 : multistart_seen_insert(ctx, &ctx->seen_optima, hash);
+		if (unique_optima < 0) {
+			atomic_store(&ctx->failed, 1);
+			break;
+		}
+		if (unique_optima)
+			eventlog_logdouble("unique_optima", current_iteration, unique_optima);
 
-free_solution_buffers:
+		if (unique_optima && incumbent) {
+			pthread_mutex_lock(&tsp->incumbent_lock);
+			memcpy(incumbent, tsp->solution_permutation, sizeof(int) * tsp->nnodes);
+			double incumbent_value = tsp->solution_value;
+			pthread_mutex_unlock(&tsp->incumbent_lock);
+
+			double child_value;
+			int partitions = tsp_gpx(&gpx, tsp, incumbent, incumbent_value, current_solution,
+						 current_solution_value, child, &child_value);
+			if (partitions > 0 &&
+			    tsp_save_solution_shared(tsp, child, child_value, current_iteration)) {
+				int improvements = atomic_fetch_add(&ctx->gpx_improvements, 1) + 1;
+				eventlog_logdouble("gpx_improvements", current_iteration, improvements);
+			}
+		}
+	}
 
+free_worker_buffers:
+	if (incumbent)
+		gpx_workspace_free(&gpx);
+	free(incumbent);
+	free(child);
 	free(current_solution);
-	free(to_extract);
+	return NULL;
+}
 
+/**
+ * If prune is set, the constructor is ignored and the greedy construction
+ * is abandoned as soon as it can't beat the incumbent anymore, or the best
+ * greedy tour if the tours are then optimized with 2opt.
+ *
+ * Every worker thread takes the next starting node from a shared counter
+ * and works on its own buffers. Only the updates of the incumbent and of
+ * the sets of seen tours are serialized.
+ * */
+static int multistart(struct tsp* tsp, tsp_constructor constructor, int use2opt, int prune)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (!tsp->nnodes)
+		return -1;
+
+	tsp->solution_value = 10e30;
+
+	// random order of the starting nodes
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+	int* start_order = malloc(sizeof(int) * tsp->nnodes);
+	for (int i = 0; i < tsp->nnodes; i++)
+		start_order[i] = i;
+	for (int i = tsp->nnodes - 1; i > 0; i--) {
+		int r = rng_randint(&rng, i + 1);
+		int temp = start_order[i];
+		start_order[i] = start_order[r];
+		start_order[r] = temp;
+	}
+
+	struct multistart_context ctx = {
+	    .tsp = tsp,
+	    .constructor = constructor,
+	    .use2opt = use2opt,
+	    .bound = NULL,
+	    .start_order = start_order,
+	};
+	atomic_init(&ctx.next_start, 0);
+	atomic_init(&ctx.iteration, 0);
+	atomic_init(&ctx.starts, 0);
+	atomic_init(&ctx.pruned, 0);
+	atomic_init(&ctx.best_greedy, 10e30);
+	atomic_init(&ctx.duplicates, 0);
+	atomic_init(&ctx.merged, 0);
+	atomic_init(&ctx.gpx_improvements, 0);
+	atomic_init(&ctx.failed, 0);
+	pthread_mutex_init(&ctx.seen_lock, NULL);
+	if (hashset_init(&ctx.seen_tours, tsp->nnodes) || hashset_init(&ctx.seen_optima, tsp->nnodes)) {
+		hashset_free(&ctx.seen_tours);
+		hashset_free(&ctx.seen_optima);
+		pthread_mutex_destroy(&ctx.seen_lock);
+		free(start_order);
+		return -1;
+	}
+
+	struct tsp_greedy_bound bound;
+	// too few nodes for the bound: never prune
+	if (prune && !tsp_greedy_bound_init(tsp, &bound, 10))
+		ctx.bound = &bound;
+
+	int nthreads = tsp_getnthreads(tsp);
+	pthread_t* threads = malloc(sizeof(pthread_t) * nthreads);
+
+	tsp_starttimer(tsp);
+
+	int started = 0;
+	for (; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, multistart_worker, &ctx)) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	int starts = atomic_load(&ctx.starts);
+	double elapsed = tsp_getelapsedseconds(tsp);
+	fprintf(stderr, "Starts: %d in %lf s (%lf/s) with %d threads\n", starts, elapsed,
+		elapsed > 0 ? starts / elapsed : 0, started);
+	if (prune)
+		fprintf(stderr, "Pruned starts: %d/%d\n", atomic_load(&ctx.pruned), starts);
+	if (use2opt)
+		fprintf(stderr, "Duplicate starts: %d/%d, merged descents: %d, unique local optima: %d\n",
+			atomic_load(&ctx.duplicates), starts, atomic_load(&ctx.merged), ctx.seen_optima.size);
+	if (use2opt && use_gpx)
+		fprintf(stderr, "Incumbents found by partition crossover: %d\n", atomic_load(&ctx.gpx_improvements));
+
+	if (ctx.bound)
+		tsp_greedy_bound_free(&bound);
+	hashset_free(&ctx.seen_tours);
+	hashset_free(&ctx.seen_optima);
+	pthread_mutex_destroy(&ctx.seen_lock);
+	free(threads);
+	free(start_order);
+
+	if (started == 0 || atomic_load(&ctx.failed))
+		return -1;
 	return 0;
 }
+
+int tsp_solve_singlestart(struct tsp* tsp, tsp_constructor constructor)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	// some constructors only read the coordinates, through tsp_cost
+	if (!tsp->cost_matrix && !tsp->costfunction)
+		return -1;
+
+	if (!tsp->nnodes)
+		return -1;
+
+	tsp_starttimer(tsp);
+
+	if (constructor(tsp, 0, tsp->solution_permutation, &tsp->solution_value)) {
+		fprintf(stderr, "Can't solve greedy!\n");
+		return -1;
+	}
+	tsp_log_incumbent(tsp, 0, tsp->solution_value);
+
+	return 0;
+}
+
+int tsp_solve_singlestart_localsearch(struct tsp* tsp, tsp_constructor constructor)
+{
+	if (tsp_solve_singlestart(tsp, constructor))
+		return -1;
+
+	int n = tsp->nnodes;
+	int res = 0;
+	int* position = malloc(sizeof(int) * n);
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	if (!position || candidates_build(tsp, GREEDY_CANDIDATES, &cand) || local_search_init(&ls, &cand)) {
+		res = -1;
+		goto free_buffers;
+	}
+	ls.oropt = 1;
+	for (int i = 0; i < n; i++)
+		position[tsp->solution_permutation[i]] = i;
+
+	local_search_push_all(&ls);
+	int moves = local_search_2opt(tsp, &ls, tsp->solution_permutation, position, &tsp->solution_value);
+	tsp_log_incumbent(tsp, 1, tsp->solution_value);
+	fprintf(stderr, "Local search: %d moves in %lf s\n", moves, tsp_getelapsedseconds(tsp));
+
+free_buffers:
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
+	return res;
+}
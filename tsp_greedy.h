@@ -2,19 +2,109 @@
 #define TSP_GREEDY_
 
 #include "tsp.h"
+#include "tsp_candidates.h"
 #include <time.h>
 
+/**
+ * A construction heuristic that builds a tour from a starting node.
+ * Output buffers have to be preallocated
+ * */
+typedef int (*tsp_constructor)(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
 /**
  * Solve a tsp instance a pure greedy approach
  * */
 int tsp_solve_greedy(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
 
+/**
+ * Same as tsp_solve_greedy, reading only the cost matrix.
+ *
+ * The unvisited nodes are kept as a compacted list in increasing order and
+ * the row of the current node is scanned with a SIMD min-reduction
+ * (AVX2 when available, SSE2 otherwise). Ties are broken by the lowest
+ * node index.
+ * */
+int tsp_solve_greedy_dense(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
+/**
+ * Greedy edge construction, with the signature of a tsp_constructor: the
+ * edges of the candidate graph (candidates_build) are added by increasing
+ * cost when both ends have degree less than 2 and no cycle is closed, then
+ * the fragments are joined in nearest neighbour order of their ends.
+ *
+ * Costs are read with tsp_cost, so with candidates that don't need it
+ * (CANDIDATES_DELAUNAY) the cost matrix is never used. The starting node
+ * is only the first node of the output.
+ * */
+int tsp_solve_greedy_edge(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
+/**
+ * Candidate lists used to bound the cost needed to complete a partial tour
+ * */
+struct tsp_greedy_bound {
+	struct candidates cand; // k cheapest neighbours of each node, sorted by cost
+	double* costs;          // cost of the corresponding edges
+};
+
+int tsp_greedy_bound_init(const struct tsp* tsp, struct tsp_greedy_bound* bound, int k);
+void tsp_greedy_bound_free(struct tsp_greedy_bound* bound);
+
+/**
+ * Same as tsp_solve_greedy, but the construction is abandoned as soon as
+ * the partial cost plus a lower bound on the cost of visiting the
+ * remaining nodes exceeds cutoff.
+ *
+ * If bound is NULL the construction is never abandoned.
+ *
+ * returns 1 if the construction has been abandoned
+ * */
+int tsp_solve_greedy_bounded(struct tsp* tsp,
+			     int starting_node,
+			     const struct tsp_greedy_bound* bound,
+			     double cutoff,
+			     int* output_solution,
+			     double* output_value);
+
 /**
  * Solve a tsp instance using the greedy multistart approach and the 2opt
- * optimization
+ * optimization.
+ *
+ * The starts are run in parallel by tsp_getnthreads() threads
  *
  * TODO should this be moved to another file?
  * */
 int tsp_solve_multigreedy(struct tsp* tsp, int use2opt);
 
+/**
+ * Same as tsp_solve_multigreedy, but the greedy starts that can't improve
+ * the incumbent are abandoned early. With 2opt they are compared with the
+ * best greedy tour instead, before its optimization.
+ * */
+int tsp_solve_multigreedy_pruned(struct tsp* tsp, int use2opt);
+
+/**
+ * If gpx is set, every new 2opt local optimum of the multistart is
+ * recombined with the incumbent by partition crossover, and the child
+ * replaces the incumbent when it is better
+ * */
+void multistart_setgpx(int gpx);
+
+/**
+ * Same as tsp_solve_multigreedy, using any construction heuristic
+ * */
+int tsp_solve_multistart(struct tsp* tsp, tsp_constructor constructor, int use2opt);
+
+/**
+ * Run a construction heuristic once from node 0.
+ * Used to compare construction time and quality
+ * */
+int tsp_solve_singlestart(struct tsp* tsp, tsp_constructor constructor);
+
+/**
+ * Same as tsp_solve_singlestart, followed by the 2opt and Or-opt local
+ * search on the candidate lists (tsp_localsearch.h), that also works
+ * without the cost matrix
+ * */
+int tsp_solve_singlestart_localsearch(struct tsp* tsp, tsp_constructor constructor);
+
 #endif
@@ -0,0 +1,261 @@
+#include "tsp_heldkarp.h"
+#include "tsp.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Node 0 is the start of the tour, node i + 1 of the subproblem is bit i
+ * of the sets. cost[S * m + j] is the cheapest path from node 0 through
+ * the nodes in S ending in j, infinity if j is not in S, so that the
+ * predecessors of an entry are a whole row of the table.
+ * */
+struct heldkarp {
+	int m;
+	float* cost;
+	float* dist_to; // dist_to[j * m + i] = cost of (i, j)
+	uint32_t* sets; // sets sorted by size
+	int* layer;	// first set of each size in sets
+
+	int nthreads;
+	int ready;
+	pthread_mutex_t ready_lock;
+	pthread_cond_t ready_cond;
+	pthread_barrier_t barrier;
+};
+
+/**
+ * min over i of row[i] + dist[i]
+ * */
+static float min_sum(const float* row, const float* dist, int m, int* argmin)
+{
+	int i = 0;
+	float best = INFINITY;
+#if defined(__AVX2__)
+	__m256 vbest = _mm256_set1_ps(INFINITY);
+	for (; i + 8 <= m; i += 8)
+		vbest = _mm256_min_ps(vbest, _mm256_add_ps(_mm256_loadu_ps(row + i), _mm256_loadu_ps(dist + i)));
+	float lanes[8];
+	_mm256_storeu_ps(lanes, vbest);
+	for (int l = 0; l < 8; l++)
+		best = lanes[l] < best ? lanes[l] : best;
+#elif defined(__SSE2__)
+	__m128 vbest = _mm_set1_ps(INFINITY);
+	for (; i + 4 <= m; i += 4)
+		vbest = _mm_min_ps(vbest, _mm_add_ps(_mm_loadu_ps(row + i), _mm_loadu_ps(dist + i)));
+	float lanes[4];
+	_mm_storeu_ps(lanes, vbest);
+	for (int l = 0; l < 4; l++)
+		best = lanes[l] < best ? lanes[l] : best;
+#endif
+	for (; i < m; i++) {
+		float c = row[i] + dist[i];
+		best = c < best ? c : best;
+	}
+	if (argmin) {
+		// only used to rebuild the tour, the sums are the same as above
+		*argmin = -1;
+		for (i = 0; i < m; i++) {
+			if (row[i] + dist[i] == best) {
+				*argmin = i;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+struct heldkarp_worker {
+	struct heldkarp* hk;
+	int id;
+};
+
+static void* heldkarp_worker(void* arg)
+{
+	struct heldkarp_worker* worker = arg;
+	struct heldkarp* hk = worker->hk;
+	int m = hk->m;
+
+	pthread_mutex_lock(&hk->ready_lock);
+	while (!hk->ready)
+		pthread_cond_wait(&hk->ready_cond, &hk->ready_lock);
+	pthread_mutex_unlock(&hk->ready_lock);
+
+	for (int size = 2; size <= m; size++) {
+		for (int k = hk->layer[size] + worker->id; k < hk->layer[size + 1]; k += hk->nthreads) {
+			uint32_t set = hk->sets[k];
+			float* entry = hk->cost + (size_t)set * m;
+			for (int j = 0; j < m; j++) {
+				if (set & (1u << j)) {
+					const float* row = hk->cost + (size_t)(set ^ (1u << j)) * m;
+					entry[j] = min_sum(row, hk->dist_to + (size_t)j * m, m, NULL);
+				} else {
+					entry[j] = INFINITY;
+				}
+			}
+		}
+		pthread_barrier_wait(&hk->barrier);
+	}
+	return NULL;
+}
+
+int heldkarp_solve(const struct tsp* tsp, const int* nodes, int count, int nthreads, int* order, double* value)
+{
+	if (count < 1 || count > HELDKARP_MAX_NODES)
+		return -1;
+
+	int m = count - 1;
+	order[0] = nodes[0];
+	if (m < 2) {
+		for (int i = 1; i < count; i++)
+			order[i] = nodes[i];
+		*value = count == 2 ? 2 * tsp_cost(tsp, nodes[0], nodes[1]) : 0;
+		return 0;
+	}
+
+	int res = 0;
+	size_t nsets = (size_t)1 << m;
+	struct heldkarp hk = {.m = m};
+	hk.cost = malloc(sizeof(float) * nsets * m);
+	hk.dist_to = malloc(sizeof(float) * m * m);
+	hk.sets = malloc(sizeof(uint32_t) * nsets);
+	hk.layer = calloc(m + 2, sizeof(int));
+	float* from_start = malloc(sizeof(float) * m);
+	float* to_start = malloc(sizeof(float) * m);
+	pthread_t* threads = malloc(sizeof(pthread_t) * (nthreads > 0 ? nthreads : 1));
+	struct heldkarp_worker* workers = malloc(sizeof(struct heldkarp_worker) * (nthreads > 0 ? nthreads : 1));
+	if (!hk.cost || !hk.dist_to || !hk.sets || !hk.layer || !from_start || !to_start || !threads || !workers) {
+		fprintf(stderr, "Can't allocate the Held-Karp table\n");
+		res = -1;
+		goto free_buffers;
+	}
+
+	for (int j = 0; j < m; j++) {
+		from_start[j] = tsp_cost(tsp, nodes[0], nodes[j + 1]);
+		to_start[j] = tsp_cost(tsp, nodes[j + 1], nodes[0]);
+		for (int i = 0; i < m; i++)
+			hk.dist_to[j * m + i] = i == j ? INFINITY : tsp_cost(tsp, nodes[i + 1], nodes[j + 1]);
+	}
+
+	// counting sort of the sets by size
+	for (size_t set = 1; set < nsets; set++) {
+		int size = 0;
+		for (size_t s = set; s; s &= s - 1)
+			size++;
+		hk.layer[size + 1]++;
+	}
+	for (int size = 1; size <= m; size++)
+		hk.layer[size + 1] += hk.layer[size];
+	int* next = malloc(sizeof(int) * (m + 1));
+	if (!next) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int size = 0; size <= m; size++)
+		next[size] = hk.layer[size];
+	for (size_t set = 1; set < nsets; set++) {
+		int size = 0;
+		for (size_t s = set; s; s &= s - 1)
+			size++;
+		hk.sets[next[size]++] = (uint32_t)set;
+	}
+	free(next);
+
+	for (int j = 0; j < m; j++) {
+		float* entry = hk.cost + ((size_t)1 << j) * m;
+		for (int i = 0; i < m; i++)
+			entry[i] = i == j ? from_start[j] : INFINITY;
+	}
+
+	pthread_mutex_init(&hk.ready_lock, NULL);
+	pthread_cond_init(&hk.ready_cond, NULL);
+	int started = 1;
+	for (; started < nthreads; started++) {
+		workers[started].hk = &hk;
+		workers[started].id = started;
+		if (pthread_create(&threads[started], NULL, heldkarp_worker, &workers[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	hk.nthreads = started;
+	pthread_barrier_init(&hk.barrier, NULL, started);
+	pthread_mutex_lock(&hk.ready_lock);
+	hk.ready = 1;
+	pthread_cond_broadcast(&hk.ready_cond);
+	pthread_mutex_unlock(&hk.ready_lock);
+
+	workers[0].hk = &hk;
+	workers[0].id = 0;
+	heldkarp_worker(&workers[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_barrier_destroy(&hk.barrier);
+	pthread_cond_destroy(&hk.ready_cond);
+	pthread_mutex_destroy(&hk.ready_lock);
+
+	// rebuild the tour backwards from the cheapest way back to the start
+	uint32_t set = (uint32_t)(nsets - 1);
+	int j;
+	min_sum(hk.cost + (size_t)set * m, to_start, m, &j);
+	for (int p = m; p > 0; p--) {
+		order[p] = nodes[j + 1];
+		uint32_t previous = set ^ (1u << j);
+		if (previous == 0)
+			break;
+		min_sum(hk.cost + (size_t)previous * m, hk.dist_to + (size_t)j * m, m, &j);
+		set = previous;
+	}
+
+	// the table is in single precision, the value is computed again
+	*value = 0;
+	for (int p = 0; p < count; p++)
+		*value += tsp_cost(tsp, order[p], order[p + 1 == count ? 0 : p + 1]);
+
+free_buffers:
+	free(workers);
+	free(threads);
+	free(to_start);
+	free(from_start);
+	free(hk.layer);
+	free(hk.sets);
+	free(hk.dist_to);
+	free(hk.cost);
+	return res;
+}
+
+int tsp_solve_heldkarp(struct tsp* tsp)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (tsp->nnodes > HELDKARP_MAX_NODES) {
+		fprintf(stderr, "Held-Karp is limited to %d nodes\n", HELDKARP_MAX_NODES);
+		return -1;
+	}
+
+	int n = tsp->nnodes;
+	int* nodes = malloc(sizeof(int) * n);
+	if (!nodes)
+		return -1;
+	for (int i = 0; i < n; i++)
+		nodes[i] = i;
+
+	tsp_starttimer(tsp);
+	int res = heldkarp_solve(tsp, nodes, n, tsp_getnthreads(tsp), tsp->solution_permutation, &tsp->solution_value);
+	if (!res) {
+		tsp_log_incumbent(tsp, 0, tsp->solution_value);
+		fprintf(stderr, "Held-Karp: %d nodes in %lf s\n", n, tsp_getelapsedseconds(tsp));
+	}
+
+	free(nodes);
+	return res;
+}
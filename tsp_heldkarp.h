@@ -0,0 +1,30 @@
+#ifndef TSP_HELDKARP_H_
+#define TSP_HELDKARP_H_
+
+#include "tsp.h"
+
+// the table has 2^(n - 1) * (n - 1) floats, about 770MB for 24 nodes
+#define HELDKARP_MAX_NODES 24
+
+/**
+ * Optimal tour through nodes[0 ... count - 1] with Held-Karp dynamic
+ * programming, for count <= HELDKARP_MAX_NODES. Costs are read with
+ * tsp_cost, so the cost matrix is not needed.
+ *
+ * The subsets of nodes are processed in layers of equal size, each layer
+ * split across nthreads threads. Each entry of the table is a SIMD
+ * min-reduction over its predecessors.
+ *
+ * order receives the nodes in tour order starting from nodes[0], value its
+ * cost.
+ *
+ * returns -1 on error
+ * */
+int heldkarp_solve(const struct tsp* tsp, const int* nodes, int count, int nthreads, int* order, double* value);
+
+/**
+ * Solve a tsp instance with at most HELDKARP_MAX_NODES nodes exactly
+ * */
+int tsp_solve_heldkarp(struct tsp* tsp);
+
+#endif // TSP_HELDKARP_H_
@@ -0,0 +1,251 @@
+#include "tsp_insertion.h"
+#include "heap.h"
+#include "tsp.h"
+#include <stdlib.h>
+#include <string.h>
+
+int use_hull = 0;
+
+void insertion_setusehull(int hull)
+{
+	use_hull = hull;
+}
+
+struct hull_point {
+	double x;
+	double y;
+	int node;
+};
+
+static int hull_point_compar(const void* a, const void* b)
+{
+	const struct hull_point* pa = a;
+	const struct hull_point* pb = b;
+	if (pa->x != pb->x)
+		return pa->x < pb->x ? -1 : 1;
+	if (pa->y != pb->y)
+		return pa->y < pb->y ? -1 : 1;
+	return 0;
+}
+
+static double hull_cross(const struct hull_point* o, const struct hull_point* a, const struct hull_point* b)
+{
+	return (a->x - o->x) * (b->y - o->y) - (a->y - o->y) * (b->x - o->x);
+}
+
+/**
+ * Andrew's monotone chain
+ * */
+int tsp_convex_hull(const struct tsp* tsp, int* hull)
+{
+	int n = tsp->nnodes;
+	if (n < 3) {
+		for (int i = 0; i < n; i++)
+			hull[i] = i;
+		return n;
+	}
+
+	struct hull_point* points = malloc(sizeof(struct hull_point) * n);
+	struct hull_point** chain = malloc(sizeof(struct hull_point*) * 2 * n);
+	for (int i = 0; i < n; i++) {
+		points[i].x = tsp->coords[i].x;
+		points[i].y = tsp->coords[i].y;
+		points[i].node = i;
+	}
+	qsort(points, n, sizeof(struct hull_point), hull_point_compar);
+
+	int k = 0;
+	// lower hull
+	for (int i = 0; i < n; i++) {
+		while (k >= 2 && hull_cross(chain[k - 2], chain[k - 1], &points[i]) <= 0)
+			k--;
+		chain[k++] = &points[i];
+	}
+	// upper hull
+	for (int i = n - 2, t = k + 1; i >= 0; i--) {
+		while (k >= t && hull_cross(chain[k - 2], chain[k - 1], &points[i]) <= 0)
+			k--;
+		chain[k++] = &points[i];
+	}
+
+	// the last point is equal to the first one
+	int size = k - 1;
+	for (int i = 0; i < size; i++)
+		hull[i] = chain[i]->node;
+
+	free(chain);
+	free(points);
+	return size;
+}
+
+static double insertion_cost(const struct tsp* tsp, int from, int to, int node)
+{
+	return tsp->cost_matrix[flatten_coords(from, node, tsp->nnodes)] +
+	       tsp->cost_matrix[flatten_coords(node, to, tsp->nnodes)] -
+	       tsp->cost_matrix[flatten_coords(from, to, tsp->nnodes)];
+}
+
+/**
+ * Scans the whole tour to find the cheapest edge where node can be inserted.
+ *
+ * Returns the tail of the edge
+ * */
+static int insertion_findbestedge(const struct tsp* tsp, const int* succ, int tour_node, int node, double* best_cost)
+{
+	int best_from = tour_node;
+	*best_cost = 10e30;
+	int current = tour_node;
+	do {
+		double cost = insertion_cost(tsp, current, succ[current], node);
+		if (cost < *best_cost) {
+			*best_cost = cost;
+			best_from = current;
+		}
+		current = succ[current];
+	} while (current != tour_node);
+	return best_from;
+}
+
+int tsp_solve_insertion(struct tsp* tsp, int type, int starting_node, int* output_solution, double* output_value)
+{
+	if (starting_node < 0 || starting_node >= tsp->nnodes)
+		return -1;
+
+	if (output_solution == NULL || output_value == NULL)
+		return -1;
+
+	if (type != TSP_INSERTION_NEAREST && type != TSP_INSERTION_FARTHEST && type != TSP_INSERTION_CHEAPEST)
+		return -1;
+
+	int n = tsp->nnodes;
+	int* succ = malloc(sizeof(int) * n);
+	char* in_tour = calloc(n, sizeof(char));
+	// cheapest: tail of the best edge where the node can be inserted
+	int* best_from = malloc(sizeof(int) * n);
+	struct heap heap;
+	if (heap_init(&heap, n)) {
+		free(succ);
+		free(in_tour);
+		free(best_from);
+		return -1;
+	}
+
+	// initial tour
+	double tour_value = 0;
+	int tour_node = starting_node;
+	int hull_size = 0;
+	if (use_hull) {
+		hull_size = tsp_convex_hull(tsp, output_solution);
+		tour_node = output_solution[0];
+	}
+	if (hull_size >= 2) {
+		for (int i = 0; i < hull_size; i++) {
+			int from = output_solution[i];
+			int to = output_solution[(i + 1) % hull_size];
+			succ[from] = to;
+			in_tour[from] = 1;
+			tour_value += tsp->cost_matrix[flatten_coords(from, to, n)];
+		}
+	} else {
+		succ[tour_node] = tour_node;
+		in_tour[tour_node] = 1;
+	}
+
+	// initial keys
+	for (int u = 0; u < n; u++) {
+		if (in_tour[u])
+			continue;
+		if (type == TSP_INSERTION_CHEAPEST) {
+			double cost;
+			best_from[u] = insertion_findbestedge(tsp, succ, tour_node, u, &cost);
+			heap_push(&heap, u, cost);
+		} else {
+			double dist = 10e30;
+			int current = tour_node;
+			do {
+				double d = tsp->cost_matrix[flatten_coords(u, current, n)];
+				if (d < dist)
+					dist = d;
+				current = succ[current];
+			} while (current != tour_node);
+			// farthest insertion needs the maximum: negate the key
+			heap_push(&heap, u, type == TSP_INSERTION_NEAREST ? dist : -dist);
+		}
+	}
+
+	while (!heap_empty(&heap)) {
+		int v = heap_pop(&heap);
+
+		int a;
+		double cost;
+		if (type == TSP_INSERTION_CHEAPEST) {
+			a = best_from[v];
+			cost = insertion_cost(tsp, a, succ[a], v);
+		} else {
+			a = insertion_findbestedge(tsp, succ, tour_node, v, &cost);
+		}
+		int b = succ[a];
+		succ[a] = v;
+		succ[v] = b;
+		in_tour[v] = 1;
+		tour_value += cost;
+
+		// update only the nodes affected by the insertion
+		for (int u = 0; u < n; u++) {
+			if (in_tour[u])
+				continue;
+			if (type == TSP_INSERTION_CHEAPEST) {
+				if (best_from[u] == a) {
+					// the edge (a, b) does not exist anymore
+					double new_cost;
+					best_from[u] = insertion_findbestedge(tsp, succ, tour_node, u, &new_cost);
+					heap_push(&heap, u, new_cost);
+					continue;
+				}
+				double cost_av = insertion_cost(tsp, a, v, u);
+				double cost_vb = insertion_cost(tsp, v, b, u);
+				double key = heap_key(&heap, u);
+				if (cost_av < key && cost_av <= cost_vb) {
+					best_from[u] = a;
+					heap_push(&heap, u, cost_av);
+				} else if (cost_vb < key) {
+					best_from[u] = v;
+					heap_push(&heap, u, cost_vb);
+				}
+			} else {
+				double d = tsp->cost_matrix[flatten_coords(u, v, n)];
+				double dist = type == TSP_INSERTION_NEAREST ? heap_key(&heap, u) : -heap_key(&heap, u);
+				if (d < dist)
+					heap_push(&heap, u, type == TSP_INSERTION_NEAREST ? d : -d);
+			}
+		}
+	}
+
+	int current = tour_node;
+	for (int i = 0; i < n; i++) {
+		output_solution[i] = current;
+		current = succ[current];
+	}
+	*output_value = tour_value;
+
+	heap_free(&heap);
+	free(best_from);
+	free(in_tour);
+	free(succ);
+	return 0;
+}
+
+int tsp_solve_insertion_nearest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	return tsp_solve_insertion(tsp, TSP_INSERTION_NEAREST, starting_node, output_solution, output_value);
+}
+
+int tsp_solve_insertion_farthest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	return tsp_solve_insertion(tsp, TSP_INSERTION_FARTHEST, starting_node, output_solution, output_value);
+}
+
+int tsp_solve_insertion_cheapest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	return tsp_solve_insertion(tsp, TSP_INSERTION_CHEAPEST, starting_node, output_solution, output_value);
+}
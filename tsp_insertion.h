@@ -0,0 +1,45 @@
+#ifndef TSP_INSERTION_
+#define TSP_INSERTION_
+
+#include "tsp.h"
+
+#define TSP_INSERTION_NEAREST  0
+#define TSP_INSERTION_FARTHEST 1
+#define TSP_INSERTION_CHEAPEST 2
+
+/**
+ * If set, the insertion starts from the convex hull of the nodes
+ * instead of the starting node alone (the starting node is then ignored)
+ * */
+void insertion_setusehull(int use_hull);
+
+/**
+ * Solve a tsp instance with an insertion heuristic.
+ *
+ * type selects the node to insert at each step:
+ * - TSP_INSERTION_NEAREST: the node closest to the tour
+ * - TSP_INSERTION_FARTHEST: the node farthest from the tour
+ * - TSP_INSERTION_CHEAPEST: the node with the cheapest insertion
+ *
+ * The selected node is always inserted in the cheapest position.
+ * Output buffers have to be preallocated
+ * */
+int tsp_solve_insertion(struct tsp* tsp, int type, int starting_node, int* output_solution, double* output_value);
+
+/**
+ * Same as tsp_solve_insertion, with the signature of a tsp_constructor
+ * */
+int tsp_solve_insertion_nearest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+int tsp_solve_insertion_farthest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+int tsp_solve_insertion_cheapest(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
+/**
+ * Computes the convex hull of the nodes in counterclockwise order.
+ *
+ * hull should be preallocated with size nnodes
+ *
+ * Returns the number of nodes of the hull
+ * */
+int tsp_convex_hull(const struct tsp* tsp, int* hull);
+
+#endif
@@ -0,0 +1,403 @@
+#include "tsp_localsearch.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the time limit is checked once every this many nodes
+#define LOCAL_SEARCH_CHECK_INTERVAL 256
+
+int local_search_init(struct local_search* ls, const struct candidates* cand)
+{
+	ls->nnodes = cand->nnodes;
+	ls->cand = cand;
+	ls->head = 0;
+	ls->size = 0;
+	ls->oropt = 0;
+	ls->journaling = 0;
+	ls->journal = NULL;
+	ls->journal_size = 0;
+	ls->journal_capacity = 0;
+	ls->penalties = NULL;
+	ls->lambda = 0;
+	ls->queue = malloc(sizeof(int) * ls->nnodes);
+	ls->queued = calloc(ls->nnodes, sizeof(char));
+	if (!ls->queue || !ls->queued) {
+		local_search_free(ls);
+		return -1;
+	}
+	return 0;
+}
+
+void local_search_free(struct local_search* ls)
+{
+	free(ls->queue);
+	free(ls->queued);
+	free(ls->journal);
+	ls->queue = NULL;
+	ls->queued = NULL;
+	ls->journal = NULL;
+}
+
+static inline uint64_t penalty_key(int a, int b)
+{
+	// a != b, so the key is never 0
+	return a < b ? (uint64_t)a << 32 | (uint32_t)b : (uint64_t)b << 32 | (uint32_t)a;
+}
+
+static inline int penalty_slot(uint64_t key, int capacity)
+{
+	return (int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+int penalty_map_init(struct penalty_map* map, int nnodes)
+{
+	map->capacity = 1024;
+	map->size = 0;
+	map->keys = calloc(map->capacity, sizeof(uint64_t));
+	map->values = malloc(sizeof(int) * map->capacity);
+	map->degree = calloc(nnodes, sizeof(int));
+	if (!map->keys || !map->values || !map->degree) {
+		penalty_map_free(map);
+		return -1;
+	}
+	return 0;
+}
+
+void penalty_map_free(struct penalty_map* map)
+{
+	free(map->keys);
+	free(map->values);
+	free(map->degree);
+	map->keys = NULL;
+	map->values = NULL;
+	map->degree = NULL;
+}
+
+int penalty_map_get(const struct penalty_map* map, int a, int b)
+{
+	// most nodes have no penalized edge, skip the lookup
+	if (map->degree[a] == 0 || map->degree[b] == 0)
+		return 0;
+	uint64_t key = penalty_key(a, b);
+	for (int i = penalty_slot(key, map->capacity); map->keys[i]; i = (i + 1) & (map->capacity - 1)) {
+		if (map->keys[i] == key)
+			return map->values[i];
+	}
+	return 0;
+}
+
+static int penalty_map_grow(struct penalty_map* map)
+{
+	int capacity = map->capacity * 2;
+	uint64_t* keys = calloc(capacity, sizeof(uint64_t));
+	int* values = malloc(sizeof(int) * capacity);
+	if (!keys || !values) {
+		free(keys);
+		free(values);
+		return -1;
+	}
+	for (int i = 0; i < map->capacity; i++) {
+		if (!map->keys[i])
+			continue;
+		int j = penalty_slot(map->keys[i], capacity);
+		while (keys[j])
+			j = (j + 1) & (capacity - 1);
+		keys[j] = map->keys[i];
+		values[j] = map->values[i];
+	}
+	free(map->keys);
+	free(map->values);
+	map->keys = keys;
+	map->values = values;
+	map->capacity = capacity;
+	return 0;
+}
+
+int penalty_map_increment(struct penalty_map* map, int a, int b)
+{
+	if (2 * (map->size + 1) > map->capacity && penalty_map_grow(map))
+		return -1;
+	uint64_t key = penalty_key(a, b);
+	int i = penalty_slot(key, map->capacity);
+	while (map->keys[i] && map->keys[i] != key)
+		i = (i + 1) & (map->capacity - 1);
+	if (map->keys[i] == key) {
+		map->values[i]++;
+		return 0;
+	}
+	map->keys[i] = key;
+	map->values[i] = 1;
+	map->size++;
+	map->degree[a]++;
+	map->degree[b]++;
+	return 0;
+}
+
+/**
+ * Cost of the edge (a, b) seen by the moves
+ * */
+static inline double move_cost(const struct tsp* tsp, const struct local_search* ls, int a, int b)
+{
+	double cost = tsp_cost(tsp, a, b);
+	if (ls->penalties)
+		cost += ls->lambda * penalty_map_get(ls->penalties, a, b);
+	return cost;
+}
+
+// journal entries are triples (kind, i, j)
+#define JOURNAL_SWAP    0
+#define JOURNAL_REVERSE 1
+
+static int journal_record(struct local_search* ls, int kind, int i, int j)
+{
+	if (!ls->journaling)
+		return 0;
+	if (ls->journal_size + 3 > ls->journal_capacity) {
+		int capacity = ls->journal_capacity ? ls->journal_capacity * 2 : 3 * 64;
+		int* journal = realloc(ls->journal, sizeof(int) * capacity);
+		if (!journal)
+			return -1;
+		ls->journal = journal;
+		ls->journal_capacity = capacity;
+	}
+	ls->journal[ls->journal_size++] = kind;
+	ls->journal[ls->journal_size++] = i;
+	ls->journal[ls->journal_size++] = j;
+	return 0;
+}
+
+static void reverse_positions(int left, int right, int* solution, int* position)
+{
+	while (left < right) {
+		int temp = solution[left];
+		solution[left] = solution[right];
+		solution[right] = temp;
+		position[solution[left]] = left;
+		position[solution[right]] = right;
+		left++;
+		right--;
+	}
+}
+
+int local_search_swap(struct local_search* ls, int i, int j, int* solution, int* position)
+{
+	tsp_2opt_swap_pos(i, j, solution, position, ls->nnodes);
+	return journal_record(ls, JOURNAL_SWAP, i, j);
+}
+
+int local_search_reverse(struct local_search* ls, int left, int right, int* solution, int* position)
+{
+	reverse_positions(left, right, solution, position);
+	return journal_record(ls, JOURNAL_REVERSE, left, right);
+}
+
+void local_search_commit(struct local_search* ls)
+{
+	ls->journal_size = 0;
+}
+
+void local_search_undo(struct local_search* ls, int* solution, int* position)
+{
+	for (int k = ls->journal_size - 3; k >= 0; k -= 3) {
+		if (ls->journal[k] == JOURNAL_SWAP)
+			tsp_2opt_swap_pos(ls->journal[k + 1], ls->journal[k + 2], solution, position, ls->nnodes);
+		else
+			reverse_positions(ls->journal[k + 1], ls->journal[k + 2], solution, position);
+	}
+	ls->journal_size = 0;
+}
+
+void local_search_push(struct local_search* ls, int node)
+{
+	if (ls->queued[node])
+		return;
+	ls->queued[node] = 1;
+	ls->queue[(ls->head + ls->size) % ls->nnodes] = node;
+	ls->size++;
+}
+
+void local_search_push_all(struct local_search* ls)
+{
+	for (int i = 0; i < ls->nnodes; i++)
+		local_search_push(ls, i);
+}
+
+static int local_search_pop(struct local_search* ls)
+{
+	int node = ls->queue[ls->head];
+	ls->head = (ls->head + 1) % ls->nnodes;
+	ls->size--;
+	ls->queued[node] = 0;
+	return node;
+}
+
+/**
+ * Looks for an improving move removing one of the two tour edges of a and
+ * adding (a, c), with c candidate of a. The first one found is applied.
+ *
+ * returns 1 if a move has been applied
+ * */
+static int improve_node(struct tsp* tsp, struct local_search* ls, int* solution, int* position, double* value, int a)
+{
+	int n = tsp->nnodes;
+	const struct candidates* cand = ls->cand;
+	int sa = solution[position[a] + 1 == n ? 0 : position[a] + 1];
+	int pa = solution[position[a] == 0 ? n - 1 : position[a] - 1];
+	double d_sa = move_cost(tsp, ls, a, sa);
+	double d_pa = move_cost(tsp, ls, pa, a);
+
+	for (int k = cand->offset[a]; k < cand->offset[a + 1]; k++) {
+		int c = cand->nodes[k];
+		// candidates are sorted and penalties only add cost, no later c can
+		// give a gain
+		double cost_ac = tsp_cost(tsp, a, c);
+		if (cost_ac >= d_sa && cost_ac >= d_pa)
+			break;
+		double d_ac = move_cost(tsp, ls, a, c);
+
+		// remove (a, sa), (c, sc), add (a, c), (sa, sc)
+		int sc = solution[position[c] + 1 == n ? 0 : position[c] + 1];
+		if (c != sa && sc != a) {
+			double delta = d_sa + move_cost(tsp, ls, c, sc) - d_ac - move_cost(tsp, ls, sa, sc);
+			if (delta > EPSILON) {
+				int i = position[a], j = position[c];
+				local_search_swap(ls, i < j ? i : j, i < j ? j : i, solution, position);
+				*value -= delta;
+				local_search_push(ls, a);
+				local_search_push(ls, sa);
+				local_search_push(ls, c);
+				local_search_push(ls, sc);
+				return 1;
+			}
+		}
+
+		// remove (pa, a), (pc, c), add (a, c), (pa, pc)
+		int pc = solution[position[c] == 0 ? n - 1 : position[c] - 1];
+		if (c != pa && pc != a) {
+			double delta = d_pa + move_cost(tsp, ls, pc, c) - d_ac - move_cost(tsp, ls, pa, pc);
+			if (delta > EPSILON) {
+				int i = position[pa], j = position[pc];
+				local_search_swap(ls, i < j ? i : j, i < j ? j : i, solution, position);
+				*value -= delta;
+				local_search_push(ls, a);
+				local_search_push(ls, pa);
+				local_search_push(ls, c);
+				local_search_push(ls, pc);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int local_search_swap_edges(struct local_search* ls, int x1, int y1, int x2, int y2, int* solution, int* position)
+{
+	int i, j;
+	if (tour_succ(solution, position, ls->nnodes, x1) == y1) {
+		i = position[x1];
+		j = position[x2];
+	} else {
+		i = position[y1];
+		j = position[y2];
+	}
+	return local_search_swap(ls, i < j ? i : j, i < j ? j : i, solution, position);
+}
+
+int local_search_oropt(struct local_search* ls,
+		       int p,
+		       int s1,
+		       int s2,
+		       int nx,
+		       int u,
+		       int v,
+		       int forward,
+		       int* solution,
+		       int* position)
+{
+	// p s1 .. s2 nx .. u v -> p u .. nx s2 .. s1 v -> p nx .. u s2 .. s1 v
+	if (local_search_swap_edges(ls, p, s1, u, v, solution, position) ||
+	    local_search_swap_edges(ls, p, u, nx, s2, solution, position))
+		return -1;
+	// -> p nx .. u s1 .. s2 v, a single node needs no reversal
+	if (forward && s1 != s2)
+		return local_search_swap_edges(ls, u, s2, s1, v, solution, position);
+	return 0;
+}
+
+/**
+ * Looks for an improving Or-opt move taking the segment of 1 to 3 nodes
+ * starting at a and placing a next to one of its candidates.
+ *
+ * returns 1 if a move has been applied
+ * */
+static int improve_node_oropt(struct tsp* tsp, struct local_search* ls, int* solution, int* position, double* value,
+			      int a)
+{
+	int n = tsp->nnodes;
+	const struct candidates* cand = ls->cand;
+	int p = solution[position[a] == 0 ? n - 1 : position[a] - 1];
+
+	for (int len = 1; len <= 3 && len + 3 < n; len++) {
+		int s2 = solution[(position[a] + len - 1) % n];
+		int nx = solution[(position[a] + len) % n];
+		double removed = move_cost(tsp, ls, p, a) + move_cost(tsp, ls, s2, nx) - move_cost(tsp, ls, p, nx);
+
+		for (int k = cand->offset[a]; k < cand->offset[a + 1]; k++) {
+			int c = cand->nodes[k];
+			if (tsp_cost(tsp, a, c) >= removed)
+				break;
+			if ((position[c] - position[a] + n) % n < len)
+				continue;
+			double d_ac = move_cost(tsp, ls, a, c);
+
+			// u a .. s2 v with (u, v) = (c, succ c), or u s2 .. a v with
+			// (u, v) = (pred c, c)
+			for (int forward = 1; forward >= 0; forward--) {
+				int u, v;
+				double added;
+				if (forward) {
+					u = c;
+					v = solution[position[c] + 1 == n ? 0 : position[c] + 1];
+					added = d_ac + move_cost(tsp, ls, s2, v);
+				} else {
+					u = solution[position[c] == 0 ? n - 1 : position[c] - 1];
+					v = c;
+					added = d_ac + move_cost(tsp, ls, u, s2);
+				}
+				if ((position[u] - position[a] + n) % n < len ||
+				    (position[v] - position[a] + n) % n < len || u == nx || v == p)
+					continue;
+				double delta = removed + move_cost(tsp, ls, u, v) - added;
+				if (delta <= EPSILON)
+					continue;
+
+				local_search_oropt(ls, p, a, s2, nx, u, v, forward, solution, position);
+				*value -= delta;
+				local_search_push(ls, p);
+				local_search_push(ls, nx);
+				local_search_push(ls, a);
+				local_search_push(ls, s2);
+				local_search_push(ls, u);
+				local_search_push(ls, v);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int local_search_2opt(struct tsp* tsp, struct local_search* ls, int* solution, int* position, double* value)
+{
+	int moves = 0;
+	int popped = 0;
+	while (ls->size > 0) {
+		if (++popped % LOCAL_SEARCH_CHECK_INTERVAL == 0 && tsp_shouldstop(tsp))
+			break;
+		int a = local_search_pop(ls);
+		if (improve_node(tsp, ls, solution, position, value, a) ||
+		    (ls->oropt && improve_node_oropt(tsp, ls, solution, position, value, a)))
+			moves++;
+	}
+	return moves;
+}
@@ -0,0 +1,149 @@
+#ifndef TSP_LOCALSEARCH_H_
+#define TSP_LOCALSEARCH_H_
+
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include <stdint.h>
+
+/**
+ * Sparse penalties of the edges for guided local search, an open
+ * addressing map from the undirected edge to its penalty
+ * */
+struct penalty_map {
+	uint64_t* keys; // 0 for empty slots
+	int* values;
+	int* degree; // number of penalized edges of each node
+	int capacity; // always a power of 2
+	int size;
+};
+
+int penalty_map_init(struct penalty_map* map, int nnodes);
+
+void penalty_map_free(struct penalty_map* map);
+
+/**
+ * returns the penalty of the edge (a, b), 0 if it has never been penalized
+ * */
+int penalty_map_get(const struct penalty_map* map, int a, int b);
+
+/**
+ * Increment the penalty of the edge (a, b)
+ * */
+int penalty_map_increment(struct penalty_map* map, int a, int b);
+
+/**
+ * 2opt local search restricted to the candidate lists, driven by a queue
+ * of dirty nodes (don't-look bits): only the nodes in the queue are used
+ * as first endpoint of a move, and the endpoints of every applied move
+ * are queued again.
+ *
+ * The tour is kept as a permutation together with its position array
+ * (position[solution[i]] = i).
+ * */
+struct local_search {
+	int nnodes;
+	const struct candidates* cand;
+	int* queue;
+	char* queued;
+	int head;
+	int size;
+
+	// also try Or-opt moves (segments of 1 to 3 nodes) when 2opt fails
+	int oropt;
+
+	// applied moves, recorded only when journaling is set
+	int journaling;
+	int* journal;
+	int journal_size;
+	int journal_capacity;
+
+	// when set, moves are evaluated on cost + lambda * penalty
+	const struct penalty_map* penalties;
+	double lambda;
+};
+
+/**
+ * Node after (before) node in the tour
+ * */
+static inline int tour_succ(const int* solution, const int* position, int n, int node)
+{
+	int i = position[node] + 1;
+	return solution[i == n ? 0 : i];
+}
+
+static inline int tour_pred(const int* solution, const int* position, int n, int node)
+{
+	int i = position[node];
+	return solution[i == 0 ? n - 1 : i - 1];
+}
+
+int local_search_init(struct local_search* ls, const struct candidates* cand);
+
+void local_search_free(struct local_search* ls);
+
+/**
+ * Mark a node as dirty
+ * */
+void local_search_push(struct local_search* ls, int node);
+
+/**
+ * Mark every node as dirty, used for the first descent
+ * */
+void local_search_push_all(struct local_search* ls);
+
+/**
+ * Apply the 2opt move tsp_2opt_swap_pos(i, j, ...), recording it in the
+ * journal
+ * */
+int local_search_swap(struct local_search* ls, int i, int j, int* solution, int* position);
+
+/**
+ * 2opt move removing the tour edges (x1, y1), (x2, y2) and adding (x1, x2),
+ * (y1, y2), whatever the orientation of the array
+ * */
+int local_search_swap_edges(struct local_search* ls, int x1, int y1, int x2, int y2, int* solution, int* position);
+
+/**
+ * Or-opt move taking the segment s1 ... s2 (p before and nx after it) and
+ * placing it between the tour edge (u, v), with s1 next to u if forward
+ * is set, else next to v. Applied as 2 or 3 recorded 2opt moves
+ * */
+int local_search_oropt(struct local_search* ls,
+		       int p,
+		       int s1,
+		       int s2,
+		       int nx,
+		       int u,
+		       int v,
+		       int forward,
+		       int* solution,
+		       int* position);
+
+/**
+ * Reverse solution[left ... right] (no wrap around), recording it in the
+ * journal
+ * */
+int local_search_reverse(struct local_search* ls, int left, int right, int* solution, int* position);
+
+/**
+ * Forget the recorded moves, the current tour becomes the one restored by
+ * local_search_undo
+ * */
+void local_search_commit(struct local_search* ls);
+
+/**
+ * Undo the moves recorded since the last commit. Both kinds of moves are
+ * involutions, so they are applied again in reverse order
+ * */
+void local_search_undo(struct local_search* ls, int* solution, int* position);
+
+/**
+ * Apply improving 2opt (and Or-opt if enabled) moves until the queue is
+ * empty or the time limit is reached. value is updated with the cost of
+ * the moves (the augmented cost if penalties are set).
+ *
+ * returns the number of applied moves
+ * */
+int local_search_2opt(struct tsp* tsp, struct local_search* ls, int* solution, int* position, double* value);
+
+#endif // TSP_LOCALSEARCH_H_
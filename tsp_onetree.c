@@ -0,0 +1,570 @@
+#include "tsp_onetree.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_delaunay.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int onetree_init(struct onetree* tree, int nnodes)
+{
+	tree->nnodes = nnodes;
+	tree->costs = NULL;
+	tree->parent = malloc(sizeof(int) * nnodes);
+	tree->degree = malloc(sizeof(int) * nnodes);
+	tree->order = malloc(sizeof(int) * nnodes);
+	tree->key = malloc(sizeof(double) * nnodes);
+	tree->queue = malloc(sizeof(int) * nnodes);
+	tree->slot = malloc(sizeof(int) * nnodes);
+	if (!tree->parent || !tree->degree || !tree->order || !tree->key || !tree->queue || !tree->slot) {
+		onetree_free(tree);
+		return -1;
+	}
+	return 0;
+}
+
+void onetree_free(struct onetree* tree)
+{
+	free(tree->parent);
+	free(tree->degree);
+	free(tree->order);
+	free(tree->key);
+	free(tree->queue);
+	free(tree->slot);
+	tree->parent = NULL;
+	tree->degree = NULL;
+	tree->order = NULL;
+	tree->key = NULL;
+	tree->queue = NULL;
+	tree->slot = NULL;
+}
+
+static inline double onetree_cost(const struct tsp* tsp, const struct onetree* tree, int u, int v)
+{
+	return tree->costs ? tree->costs[(size_t)u * tree->nnodes + v] : tsp_cost(tsp, u, v);
+}
+
+/**
+ * Prim on the complete graph: the nodes not yet in the tree are kept
+ * compact in queue, their keys are updated and the next node is found in
+ * the same pass
+ * */
+static void onetree_dense(const struct tsp* tsp, const double* pi, struct onetree* tree)
+{
+	int n = tree->nnodes;
+	double* key = tree->key;
+	int* rest = tree->queue;
+	int size = 0;
+	for (int v = 2; v < n; v++) {
+		rest[size++] = v;
+		key[v] = INFINITY;
+		tree->parent[v] = 1;
+	}
+	const double* costs = tree->costs ? tree->costs : tsp->cost_matrix;
+
+	int u = 1, added = 0;
+	tree->parent[1] = -1;
+	tree->order[added++] = 1;
+	while (size > 0) {
+		const double* row = costs ? costs + (size_t)u * n : NULL;
+		int best = 0;
+		for (int a = 0; a < size; a++) {
+			int v = rest[a];
+			double c = (row ? row[v] : tsp_cost(tsp, u, v)) + pi[u] + pi[v];
+			if (c < key[v]) {
+				key[v] = c;
+				tree->parent[v] = u;
+			}
+			if (key[v] < key[rest[best]])
+				best = a;
+		}
+		u = rest[best];
+		rest[best] = rest[--size];
+		tree->order[added++] = u;
+		tree->value += key[u];
+		tree->degree[u]++;
+		tree->degree[tree->parent[u]]++;
+	}
+}
+
+static void heap_swap(struct onetree* tree, int a, int b)
+{
+	int u = tree->queue[a], v = tree->queue[b];
+	tree->queue[a] = v;
+	tree->queue[b] = u;
+	tree->slot[v] = a;
+	tree->slot[u] = b;
+}
+
+static void heap_up(struct onetree* tree, int a)
+{
+	while (a > 0 && tree->key[tree->queue[(a - 1) / 2]] > tree->key[tree->queue[a]]) {
+		heap_swap(tree, a, (a - 1) / 2);
+		a = (a - 1) / 2;
+	}
+}
+
+static void heap_down(struct onetree* tree, int a, int size)
+{
+	while (1) {
+		int child = 2 * a + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && tree->key[tree->queue[child + 1]] < tree->key[tree->queue[child]])
+			child++;
+		if (tree->key[tree->queue[child]] >= tree->key[tree->queue[a]])
+			break;
+		heap_swap(tree, a, child);
+		a = child;
+	}
+}
+
+/**
+ * Prim on a sparse graph with an indexed binary heap. slot is the
+ * position of a node in the heap, -1 if it hasn't been reached, -2 once
+ * it is in the tree. Node 0 is left out unless with_zero is set
+ * */
+static int onetree_sparse(const struct tsp* tsp,
+			  const struct candidates* graph,
+			  const double* pi,
+			  struct onetree* tree,
+			  int with_zero)
+{
+	int n = tree->nnodes;
+	for (int v = 0; v < n; v++)
+		tree->slot[v] = -1;
+	if (!with_zero)
+		tree->slot[0] = -2;
+
+	int size = 1, added = 0;
+	tree->queue[0] = 1;
+	tree->slot[1] = 0;
+	tree->key[1] = 0;
+	tree->parent[1] = -1;
+	while (size > 0) {
+		int u = tree->queue[0];
+		heap_swap(tree, 0, --size);
+		heap_down(tree, 0, size);
+		tree->slot[u] = -2;
+		tree->order[added++] = u;
+		if (tree->parent[u] >= 0) {
+			tree->value += tree->key[u];
+			tree->degree[u]++;
+			tree->degree[tree->parent[u]]++;
+		}
+		for (int c = graph->offset[u]; c < graph->offset[u + 1]; c++) {
+			int v = graph->nodes[c];
+			if (tree->slot[v] == -2)
+				continue;
+			double cost = onetree_cost(tsp, tree, u, v) + pi[u] + pi[v];
+			if (tree->slot[v] == -1) {
+				tree->queue[size] = v;
+				tree->slot[v] = size++;
+			} else if (cost >= tree->key[v]) {
+				continue;
+			}
+			tree->key[v] = cost;
+			tree->parent[v] = u;
+			heap_up(tree, tree->slot[v]);
+		}
+	}
+	return added == (with_zero ? n : n - 1) ? 0 : -1;
+}
+
+int onetree_compute(const struct tsp* tsp, const struct candidates* graph, const double* pi, struct onetree* tree)
+{
+	int n = tree->nnodes;
+	if (n < 3)
+		return -1;
+
+	tree->value = 0;
+	memset(tree->degree, 0, sizeof(int) * n);
+	tree->parent[0] = -1;
+	if (graph) {
+		if (onetree_sparse(tsp, graph, pi, tree, 0))
+			return -1;
+	} else {
+		onetree_dense(tsp, pi, tree);
+	}
+
+	// the two cheapest edges of node 0
+	double first = INFINITY, second = INFINITY;
+	tree->ends[0] = tree->ends[1] = -1;
+	int begin = graph ? graph->offset[0] : 1;
+	int end = graph ? graph->offset[1] : n;
+	for (int c = begin; c < end; c++) {
+		int v = graph ? graph->nodes[c] : c;
+		double cost = onetree_cost(tsp, tree, 0, v) + pi[0] + pi[v];
+		if (cost < first) {
+			second = first;
+			tree->ends[1] = tree->ends[0];
+			first = cost;
+			tree->ends[0] = v;
+		} else if (cost < second) {
+			second = cost;
+			tree->ends[1] = v;
+		}
+	}
+	if (tree->ends[1] < 0)
+		return -1;
+	tree->value += first + second;
+	tree->degree[0] = 2;
+	tree->degree[tree->ends[0]]++;
+	tree->degree[tree->ends[1]]++;
+
+	for (int v = 0; v < n; v++)
+		tree->value -= 2 * pi[v];
+	return 0;
+}
+
+/**
+ * If publish is not NULL every improvement of the bound is saved in it
+ * */
+static int ascent(const struct tsp* tsp,
+		  const struct candidates* graph,
+		  double* pi,
+		  struct onetree* tree,
+		  const int* stop,
+		  double* bound,
+		  struct tsp* publish)
+{
+	int n = tree->nnodes;
+	int res = 0;
+	double* best_pi = malloc(sizeof(double) * n);
+	int* last = calloc(n, sizeof(int)); // previous subgradient
+	if (!best_pi || !last) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	if (onetree_compute(tsp, graph, pi, tree)) {
+		res = -1;
+		goto free_buffers;
+	}
+	memcpy(best_pi, pi, sizeof(double) * n);
+	double best = tree->value;
+	if (publish)
+		tsp_save_lower_bound(publish, best, 0);
+
+	long norm = 0;
+	for (int v = 0; v < n; v++)
+		norm += (long)(tree->degree[v] - 2) * (tree->degree[v] - 2);
+
+	// one hundredth of the average edge of the tree
+	double step = tree->value > 0 ? 0.01 * tree->value / n : 1;
+	int initial_period = n / 2 > 100 ? n / 2 : 100;
+	int period = initial_period;
+	int initial_phase = 1;
+	int iteration = 0;
+	for (; period > 0 && step > EPSILON && norm != 0; period /= 2, step /= 2) {
+		for (int p = 1; p <= period && norm != 0; p++) {
+			if (stop && __atomic_load_n(stop, __ATOMIC_RELAXED))
+				goto stopped;
+			iteration++;
+			for (int v = 0; v < n; v++) {
+				int g = tree->degree[v] - 2;
+				pi[v] += step * (0.7 * g + 0.3 * last[v]);
+				last[v] = g;
+			}
+			if (onetree_compute(tsp, graph, pi, tree)) {
+				res = -1;
+				goto free_buffers;
+			}
+			norm = 0;
+			for (int v = 0; v < n; v++)
+				norm += (long)(tree->degree[v] - 2) * (tree->degree[v] - 2);
+
+			if (tree->value > best + EPSILON) {
+				best = tree->value;
+				memcpy(best_pi, pi, sizeof(double) * n);
+				if (publish)
+					tsp_save_lower_bound(publish, best, iteration);
+				if (initial_phase)
+					step *= 2;
+				if (p == period && (period *= 2) > initial_period)
+					period = initial_period;
+			} else if (initial_phase && p > period / 2) {
+				initial_phase = 0;
+				p = 0;
+				step = 3 * step / 4;
+			}
+		}
+	}
+
+stopped:
+	// the 1-tree of the last iteration is a tour: the bound is the optimum
+	if (norm == 0) {
+		memcpy(best_pi, pi, sizeof(double) * n);
+		best = tree->value;
+	}
+	memcpy(pi, best_pi, sizeof(double) * n);
+	if (onetree_compute(tsp, graph, pi, tree)) {
+		res = -1;
+		goto free_buffers;
+	}
+	*bound = best;
+
+free_buffers:
+	free(last);
+	free(best_pi);
+	return res;
+}
+
+int onetree_ascent(const struct tsp* tsp,
+		   const struct candidates* graph,
+		   double* pi,
+		   struct onetree* tree,
+		   const int* stop,
+		   double* bound)
+{
+	return ascent(tsp, graph, pi, tree, stop, bound, NULL);
+}
+
+/**
+ * Graph of the ascent: NULL up to ONETREE_DENSE_MAX nodes, the Delaunay
+ * graph for larger instances, that contains the minimum spanning tree and
+ * needs no cost matrix
+ * */
+static int ascent_graph(const struct tsp* tsp, struct candidates* graph, int* sparse)
+{
+	*sparse = tsp->nnodes > ONETREE_DENSE_MAX;
+	if (!*sparse)
+		return 0;
+	return candidates_build_delaunay(tsp, 0, graph);
+}
+
+/**
+ * Value of the minimum spanning tree of all the nodes on graph. A tour
+ * without one of its edges is a spanning tree, so this is a lower bound
+ * when graph contains the minimum spanning tree of the complete graph
+ * */
+static int spanning_tree_bound(const struct tsp* tsp, const struct candidates* graph, struct onetree* tree,
+			       double* bound)
+{
+	int n = tree->nnodes;
+	double* pi = calloc(n, sizeof(double));
+	if (!pi)
+		return -1;
+	tree->value = 0;
+	memset(tree->degree, 0, sizeof(int) * n);
+	int res = onetree_sparse(tsp, graph, pi, tree, 1);
+	*bound = tree->value;
+	free(pi);
+	return res;
+}
+
+int tsp_compute_lower_bound(struct tsp* tsp, const int* stop)
+{
+	int n = tsp->nnodes;
+	if (n < 3)
+		return -1;
+
+	int res = 0;
+	struct candidates graph = {0};
+	struct onetree tree = {0};
+	double* pi = calloc(n, sizeof(double));
+	if (!pi || onetree_init(&tree, n)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	int sparse;
+	if (ascent_graph(tsp, &graph, &sparse)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	double bound;
+	if (!sparse) {
+		res = ascent(tsp, NULL, pi, &tree, stop, &bound, tsp);
+		if (!res)
+			fprintf(stderr, "Lower bound: %lf\n", bound);
+		goto free_buffers;
+	}
+
+	// the 1-trees of the Delaunay graph may miss edges of the dense ones
+	// once pi is nonzero: only the spanning tree is published, the ascent
+	// is just an estimate
+	if (spanning_tree_bound(tsp, &graph, &tree, &bound)) {
+		res = -1;
+		goto free_buffers;
+	}
+	tsp_save_lower_bound(tsp, bound, 0);
+	fprintf(stderr, "Lower bound: %lf\n", bound);
+	res = ascent(tsp, &graph, pi, &tree, stop, &bound, NULL);
+	if (!res)
+		fprintf(stderr, "Lower bound estimate: %lf\n", bound);
+
+free_buffers:
+	onetree_free(&tree);
+	candidates_free(&graph);
+	free(pi);
+	return res;
+}
+
+/**
+ * Insert node in the list of the k smallest keys, ties broken by cost
+ * */
+static void alpha_insert(int* nodes, double* keys, double* costs, int* found, int k, int node, double key, double cost)
+{
+	if (*found == k && (key > keys[k - 1] || (key == keys[k - 1] && cost >= costs[k - 1])))
+		return;
+	int pos = *found < k ? (*found)++ : k - 1;
+	while (pos > 0 && (keys[pos - 1] > key || (keys[pos - 1] == key && costs[pos - 1] > cost))) {
+		nodes[pos] = nodes[pos - 1];
+		keys[pos] = keys[pos - 1];
+		costs[pos] = costs[pos - 1];
+		pos--;
+	}
+	nodes[pos] = node;
+	keys[pos] = key;
+	costs[pos] = cost;
+}
+
+/**
+ * Sort the candidates of node i by cost, costs is a workspace of k values
+ * */
+static void sort_by_cost(const struct tsp* tsp, int i, int* nodes, double* costs, int k)
+{
+	for (int a = 0; a < k; a++) {
+		int node = nodes[a];
+		double cost = tsp_cost(tsp, i, node);
+		int pos = a;
+		while (pos > 0 && costs[pos - 1] > cost) {
+			nodes[pos] = nodes[pos - 1];
+			costs[pos] = costs[pos - 1];
+			pos--;
+		}
+		nodes[pos] = node;
+		costs[pos] = cost;
+	}
+}
+
+int candidates_build_alpha(const struct tsp* tsp, int k, struct candidates* cand)
+{
+	int n = tsp->nnodes;
+	if (n < 3)
+		return -1;
+	if (k > n - 1)
+		k = n - 1;
+
+	int res = 0;
+	struct candidates graph = {0};
+	struct onetree tree = {0};
+	double* pi = calloc(n, sizeof(double));
+	// beta[j]: largest penalized cost on the tree path from the current node to j
+	double* beta = malloc(sizeof(double) * n);
+	int* mark = malloc(sizeof(int) * n);
+	double* keys = malloc(sizeof(double) * k);
+	double* costs = malloc(sizeof(double) * k);
+	int sparse;
+	if (!pi || !beta || !mark || !keys || !costs || onetree_init(&tree, n) ||
+	    ascent_graph(tsp, &graph, &sparse)) {
+		res = -1;
+		goto free_buffers;
+	}
+	// the penalties of the sparse ascent can diverge (see
+	// tsp_compute_lower_bound): above ONETREE_DENSE_MAX nodes alpha comes
+	// from the plain 1-tree of the Delaunay graph
+	double bound;
+	if (sparse ? onetree_compute(tsp, &graph, pi, &tree) : onetree_ascent(tsp, NULL, pi, &tree, NULL, &bound)) {
+		res = -1;
+		goto free_buffers;
+	}
+	if (sparse)
+		bound = tree.value;
+
+	cand->nnodes = n;
+	cand->offset = malloc(sizeof(int) * (n + 1));
+	cand->nodes = malloc(sizeof(int) * n * k);
+	if (!cand->offset || !cand->nodes) {
+		candidates_free(cand);
+		res = -1;
+		goto free_buffers;
+	}
+
+	// node 0 is joined to the tree by its two cheapest edges, another edge
+	// of node 0 replaces the more expensive of them
+	double special = tsp_cost(tsp, 0, tree.ends[1]) + pi[0] + pi[tree.ends[1]];
+	for (int j = 0; j < n; j++)
+		mark[j] = -1;
+	for (int i = 0; i < n; i++) {
+		int* nodes = cand->nodes + i * k;
+		int found = 0;
+		cand->offset[i] = i * k;
+		if (i == 0) {
+			for (int j = 1; j < n; j++) {
+				double cost = tsp_cost(tsp, 0, j) + pi[0] + pi[j];
+				double alpha = j == tree.ends[0] || j == tree.ends[1] ? 0 : cost - special;
+				alpha_insert(nodes, keys, costs, &found, k, j, alpha, cost);
+			}
+			sort_by_cost(tsp, i, nodes, costs, k);
+			continue;
+		}
+
+		// the path from i to the root, then every other node from its parent
+		mark[i] = i;
+		beta[i] = -INFINITY;
+		for (int u = i; tree.parent[u] >= 0; u = tree.parent[u]) {
+			int p = tree.parent[u];
+			double cost = tsp_cost(tsp, u, p) + pi[u] + pi[p];
+			beta[p] = beta[u] > cost ? beta[u] : cost;
+			mark[p] = i;
+		}
+		for (int t = 0; t < n - 1; t++) {
+			int j = tree.order[t];
+			if (j == i)
+				continue;
+			if (mark[j] != i) {
+				int p = tree.parent[j];
+				double cost = tsp_cost(tsp, j, p) + pi[j] + pi[p];
+				beta[j] = beta[p] > cost ? beta[p] : cost;
+			}
+			double cost = tsp_cost(tsp, i, j) + pi[i] + pi[j];
+			alpha_insert(nodes, keys, costs, &found, k, j, cost - beta[j], cost);
+		}
+		double cost = tsp_cost(tsp, i, 0) + pi[i] + pi[0];
+		double alpha = i == tree.ends[0] || i == tree.ends[1] ? 0 : cost - special;
+		alpha_insert(nodes, keys, costs, &found, k, 0, alpha, cost);
+		sort_by_cost(tsp, i, nodes, costs, k);
+	}
+	cand->offset[n] = n * k;
+	fprintf(stderr, "Alpha candidates from the 1-tree of value %lf\n", bound);
+
+free_buffers:
+	onetree_free(&tree);
+	candidates_free(&graph);
+	free(costs);
+	free(keys);
+	free(mark);
+	free(beta);
+	free(pi);
+	return res;
+}
+
+static void* lowerbound_run(void* arg)
+{
+	struct lowerbound_thread* lb = arg;
+	lb->res = tsp_compute_lower_bound(lb->tsp, &lb->stop);
+	return NULL;
+}
+
+int lowerbound_start(struct tsp* tsp, struct lowerbound_thread* lb)
+{
+	lb->tsp = tsp;
+	lb->stop = 0;
+	lb->res = 0;
+	if (pthread_create(&lb->thread, NULL, lowerbound_run, lb)) {
+		fprintf(stderr, "Can't create thread\n");
+		return -1;
+	}
+	return 0;
+}
+
+int lowerbound_join(struct lowerbound_thread* lb)
+{
+	__atomic_store_n(&lb->stop, 1, __ATOMIC_RELAXED);
+	pthread_join(lb->thread, NULL);
+	return lb->res;
+}
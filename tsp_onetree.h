@@ -0,0 +1,110 @@
+#ifndef TSP_ONETREE_H_
+#define TSP_ONETREE_H_
+
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include <pthread.h>
+
+// larger instances use the Delaunay graph
+#define ONETREE_DENSE_MAX 2000
+
+/**
+ * Minimum 1-tree with the costs c(i, j) + pi[i] + pi[j]: a spanning tree
+ * of the nodes 1 ... n - 1 plus the two cheapest edges of node 0.
+ * */
+struct onetree {
+	int nnodes;
+	int* parent; // parent of each node in the spanning tree, -1 for the root and node 0
+	int ends[2]; // the two edges of node 0
+	int* degree;
+	// nodes 1 ... n - 1 in the order they joined the spanning tree, so
+	// every node comes after its parent
+	int* order;
+	double value; // cost of the 1-tree minus 2 * sum of pi
+
+	// n x n costs used instead of the ones of the instance if not NULL
+	const double* costs;
+
+	// workspace of Prim's algorithm
+	double* key;
+	int* queue;
+	int* slot;
+};
+
+int onetree_init(struct onetree* tree, int nnodes);
+void onetree_free(struct onetree* tree);
+
+/**
+ * Compute the minimum 1-tree with Prim's algorithm, in O(n^2) on the
+ * dense graph if graph is NULL, in O(m log n) on graph otherwise.
+ *
+ * graph must be symmetric (see candidates_symmetrize). The spanning tree of
+ * a sparse graph is a lower bound only if the graph contains the minimum
+ * spanning tree of the dense one.
+ *
+ * returns -1 if the graph is not connected
+ * */
+int onetree_compute(const struct tsp* tsp, const struct candidates* graph, const double* pi, struct onetree* tree);
+
+/**
+ * Held-Karp lower bound: subgradient ascent on the penalties pi, starting
+ * from the given ones. The step size follows the schedule of LKH: it is
+ * doubled while the bound improves in the initial phase, then halved
+ * together with the length of the period.
+ *
+ * On return pi holds the best penalties, tree the 1-tree computed with
+ * them and bound its value. The ascent ends early if *stop becomes
+ * nonzero (stop can be NULL).
+ * */
+int onetree_ascent(const struct tsp* tsp,
+		   const struct candidates* graph,
+		   double* pi,
+		   struct onetree* tree,
+		   const int* stop,
+		   double* bound);
+
+/**
+ * Compute the Held-Karp lower bound of the instance and save it in the
+ * tsp struct as it improves. Instances with more than ONETREE_DENSE_MAX
+ * nodes save only the minimum spanning tree, computed on the Delaunay
+ * graph, and run the ascent on that graph as an estimate (see
+ * onetree_compute).
+ * */
+int tsp_compute_lower_bound(struct tsp* tsp, const int* stop);
+
+/**
+ * Candidate lists of the k nodes of smallest alpha-nearness, ties broken
+ * by cost. The alpha value of an edge is the increase of the cost of the
+ * minimum 1-tree that contains it, computed with the penalties of the
+ * subgradient ascent (as in LKH). Instances with more than
+ * ONETREE_DENSE_MAX nodes skip the ascent and use the 1-tree of the
+ * Delaunay graph with no penalties. The values of each node are computed
+ * in one pass over the tree in topological order: O(n^2) time, O(n) memory
+ * besides the lists.
+ *
+ * Once selected, each list is sorted by cost like the other types.
+ * */
+int candidates_build_alpha(const struct tsp* tsp, int k, struct candidates* cand);
+
+/**
+ * Runs tsp_compute_lower_bound in its own thread, concurrently with a
+ * solver, so that the solver can log its gap and stop on it
+ * */
+struct lowerbound_thread {
+	struct tsp* tsp;
+	pthread_t thread;
+	int stop;
+	int res;
+};
+
+int lowerbound_start(struct tsp* tsp, struct lowerbound_thread* lb);
+
+/**
+ * Stop the computation of the bound if it is still running and wait for
+ * the thread
+ *
+ * returns the result of tsp_compute_lower_bound
+ * */
+int lowerbound_join(struct lowerbound_thread* lb);
+
+#endif // TSP_ONETREE_H_
@@ -0,0 +1,276 @@
+#include "tsp_som.h"
+#include "grid.h"
+#include "tsp.h"
+#include "util.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SOM_INITIAL_NEURONS 16
+// the ring is doubled until it has at least this many neurons per node
+#define SOM_NEURONS_PER_NODE 2
+// nodes presented at each size of the ring, per neuron (per node once
+// there are more neurons than nodes)
+#define SOM_PRESENTATIONS 4
+// neighbours of the winner pulled on each side
+#define SOM_RADIUS 4
+#define SOM_LEARNING_START 0.6f
+#define SOM_LEARNING_END   0.05f
+// neurons per cell of the grid index
+#define SOM_CELL_NEURONS 2
+
+/**
+ * Ring of neurons in SoA layout, with a grid index of their positions.
+ *
+ * The grid is rebuilt only once in a while, neurons that moved to another
+ * cell in the meantime are still found in their old one, so the winner is
+ * only approximately the nearest neuron.
+ * */
+struct som {
+	int size;
+	float* x;
+	float* y;
+	struct grid grid;
+};
+
+static int som_build_grid(struct som* som, float minx, float miny, float width, float height)
+{
+	if (grid_resize(&som->grid, minx, miny, width, height, som->size, SOM_CELL_NEURONS))
+		return -1;
+	for (int i = 0; i < som->size; i++) {
+		int col, row;
+		som->grid.item_cell[i] = grid_cell(&som->grid, som->x[i], som->y[i], &col, &row);
+	}
+	grid_fill(&som->grid, som->size);
+	return 0;
+}
+
+/**
+ * Nearest neuron to (px, py), visiting the rings of cells around the one
+ * of the point until no closer neuron can be found
+ * */
+static int som_winner(const struct som* som, float px, float py)
+{
+	const struct grid* grid = &som->grid;
+	int col, row;
+	grid_cell(grid, px, py, &col, &row);
+	int best = -1;
+	float best_d2 = INFINITY;
+	int max_ring = grid->cols > grid->rows ? grid->cols : grid->rows;
+	for (int ring = 0; ring <= max_ring; ring++) {
+		if (best >= 0 && best_d2 <= (ring - 1) * grid->cell * (ring - 1) * grid->cell)
+			break;
+		struct grid_ring it;
+		int cell;
+		grid_ring_start(&it, col, row, ring);
+		while ((cell = grid_ring_next(grid, &it)) >= 0) {
+			for (int k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++) {
+				int i = grid->cell_items[k];
+				float dx = som->x[i] - px, dy = som->y[i] - py;
+				float d2 = dx * dx + dy * dy;
+				if (d2 < best_d2) {
+					best_d2 = d2;
+					best = i;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+/**
+ * x += rate * g * (px - x) and the same for y, on count neurons
+ * */
+static void som_pull(float* x, float* y, const float* g, int count, float px, float py, float rate)
+{
+	int k = 0;
+#if defined(__AVX2__)
+	__m256 vpx = _mm256_set1_ps(px);
+	__m256 vpy = _mm256_set1_ps(py);
+	__m256 vrate = _mm256_set1_ps(rate);
+	for (; k + 8 <= count; k += 8) {
+		__m256 f = _mm256_mul_ps(vrate, _mm256_loadu_ps(g + k));
+		__m256 vx = _mm256_loadu_ps(x + k);
+		__m256 vy = _mm256_loadu_ps(y + k);
+		_mm256_storeu_ps(x + k, _mm256_add_ps(vx, _mm256_mul_ps(f, _mm256_sub_ps(vpx, vx))));
+		_mm256_storeu_ps(y + k, _mm256_add_ps(vy, _mm256_mul_ps(f, _mm256_sub_ps(vpy, vy))));
+	}
+#elif defined(__SSE2__)
+	__m128 vpx = _mm_set1_ps(px);
+	__m128 vpy = _mm_set1_ps(py);
+	__m128 vrate = _mm_set1_ps(rate);
+	for (; k + 4 <= count; k += 4) {
+		__m128 f = _mm_mul_ps(vrate, _mm_loadu_ps(g + k));
+		__m128 vx = _mm_loadu_ps(x + k);
+		__m128 vy = _mm_loadu_ps(y + k);
+		_mm_storeu_ps(x + k, _mm_add_ps(vx, _mm_mul_ps(f, _mm_sub_ps(vpx, vx))));
+		_mm_storeu_ps(y + k, _mm_add_ps(vy, _mm_mul_ps(f, _mm_sub_ps(vpy, vy))));
+	}
+#endif
+	for (; k < count; k++) {
+		float f = rate * g[k];
+		x[k] += f * (px - x[k]);
+		y[k] += f * (py - y[k]);
+	}
+}
+
+/**
+ * Pulls the winner and its neighbours along the ring, g has 2 radius + 1
+ * weights centered on the winner
+ * */
+static void som_update(struct som* som, int winner, const float* g, int radius, float px, float py, float rate)
+{
+	int count = 2 * radius + 1;
+	if (count > som->size) {
+		count = som->size;
+		radius = (count - 1) / 2;
+	}
+	int first = winner - radius;
+	if (first < 0)
+		first += som->size;
+	// the range wraps around the end of the arrays at most once
+	int head = som->size - first < count ? som->size - first : count;
+	som_pull(som->x + first, som->y + first, g, head, px, py, rate);
+	if (head < count)
+		som_pull(som->x, som->y, g + head, count - head, px, py, rate);
+}
+
+/**
+ * Inserts a neuron in the middle of every edge of the ring
+ * */
+static void som_double(struct som* som)
+{
+	for (int i = som->size - 1; i >= 0; i--) {
+		int next = i + 1 == som->size ? 0 : i + 1;
+		float mx = (som->x[i] + som->x[next]) / 2;
+		float my = (som->y[i] + som->y[next]) / 2;
+		som->x[2 * i + 1] = mx;
+		som->y[2 * i + 1] = my;
+		som->x[2 * i] = som->x[i];
+		som->y[2 * i] = som->y[i];
+	}
+	som->size *= 2;
+}
+
+int tsp_solve_som(struct tsp* tsp, int starting_node, int* output_solution, double* output_value)
+{
+	int n = tsp->nnodes;
+	if (n < 3 || !tsp->coords)
+		return -1;
+
+	int capacity = SOM_INITIAL_NEURONS;
+	while (capacity < SOM_NEURONS_PER_NODE * n)
+		capacity *= 2;
+
+	int res = 0;
+	struct som som = {0};
+	float* px = malloc(sizeof(float) * n);
+	float* py = malloc(sizeof(float) * n);
+	som.x = malloc(sizeof(float) * capacity);
+	som.y = malloc(sizeof(float) * capacity);
+	int* winner = malloc(sizeof(int) * n);
+	float* along = malloc(sizeof(float) * n);
+	int* bucket = calloc(capacity + 1, sizeof(int));
+	if (!px || !py || !som.x || !som.y || !winner || !along || !bucket) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	float minx = INFINITY, miny = INFINITY, maxx = -INFINITY, maxy = -INFINITY;
+	double cx = 0, cy = 0;
+	for (int i = 0; i < n; i++) {
+		px[i] = tsp->coords[i].x;
+		py[i] = tsp->coords[i].y;
+		minx = px[i] < minx ? px[i] : minx;
+		miny = py[i] < miny ? py[i] : miny;
+		maxx = px[i] > maxx ? px[i] : maxx;
+		maxy = py[i] > maxy ? py[i] : maxy;
+		cx += px[i];
+		cy += py[i];
+	}
+	float width = maxx - minx > 0 ? maxx - minx : 1;
+	float height = maxy - miny > 0 ? maxy - miny : 1;
+
+	// small circle around the center of the nodes
+	som.size = SOM_INITIAL_NEURONS < capacity ? SOM_INITIAL_NEURONS : capacity;
+	for (int i = 0; i < som.size; i++) {
+		double angle = 2 * M_PI * i / som.size;
+		som.x[i] = cx / n + width / 4 * cos(angle);
+		som.y[i] = cy / n + height / 4 * sin(angle);
+	}
+
+	float g[2 * SOM_RADIUS + 1];
+	for (int d = -SOM_RADIUS; d <= SOM_RADIUS; d++)
+		g[d + SOM_RADIUS] = expf(-(float)(d * d) / (2.0f * (SOM_RADIUS / 2.0f) * (SOM_RADIUS / 2.0f)));
+
+	struct rng rng;
+	rng_seed(&rng, (uint64_t)tsp->seed * 1000003 + starting_node);
+
+	while (1) {
+		long presentations = (long)SOM_PRESENTATIONS * (som.size < n ? som.size : n);
+		int rebuild = som.size > 64 ? som.size : 64;
+		for (long p = 0; p < presentations; p++) {
+			if (p % rebuild == 0 && som_build_grid(&som, minx, miny, width, height)) {
+				res = -1;
+				goto free_buffers;
+			}
+			float rate = SOM_LEARNING_START + (SOM_LEARNING_END - SOM_LEARNING_START) * p / presentations;
+			int node = rng_randint(&rng, n);
+			int w = som_winner(&som, px[node], py[node]);
+			som_update(&som, w, g, SOM_RADIUS, px[node], py[node], rate);
+		}
+		if (som.size == capacity)
+			break;
+		som_double(&som);
+	}
+
+	// nodes in the order of their winner, then of their projection on the
+	// edge leaving it
+	if (som_build_grid(&som, minx, miny, width, height)) {
+		res = -1;
+		goto free_buffers;
+	}
+	for (int i = 0; i < n; i++) {
+		int w = som_winner(&som, px[i], py[i]);
+		int next = w + 1 == som.size ? 0 : w + 1;
+		winner[i] = w;
+		along[i] = (px[i] - som.x[w]) * (som.x[next] - som.x[w]) + (py[i] - som.y[w]) * (som.y[next] - som.y[w]);
+		bucket[w + 1]++;
+	}
+	for (int w = 0; w < som.size; w++)
+		bucket[w + 1] += bucket[w];
+	for (int i = 0; i < n; i++)
+		output_solution[bucket[winner[i]]++] = i;
+	// buckets are shifted by one, each one starts where the previous ended
+	for (int start = 0, w = 0; w < som.size; w++) {
+		for (int k = start + 1; k < bucket[w]; k++) {
+			int node = output_solution[k];
+			int h = k - 1;
+			while (h >= start && along[output_solution[h]] > along[node]) {
+				output_solution[h + 1] = output_solution[h];
+				h--;
+			}
+			output_solution[h + 1] = node;
+		}
+		start = bucket[w];
+	}
+
+	*output_value = tsp_recompute_solution_arg(tsp, output_solution);
+
+free_buffers:
+	free(bucket);
+	free(along);
+	free(winner);
+	grid_free(&som.grid);
+	free(som.y);
+	free(som.x);
+	free(py);
+	free(px);
+	return res;
+}
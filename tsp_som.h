@@ -0,0 +1,22 @@
+#ifndef TSP_SOM_H_
+#define TSP_SOM_H_
+
+#include "tsp.h"
+
+/**
+ * Solve a tsp instance with a self-organizing map, with the signature of
+ * a tsp_constructor. Only the coordinates are read, so it works without
+ * the cost matrix.
+ *
+ * A ring of neurons is pulled towards randomly chosen nodes: the neuron
+ * nearest to the node (found with a grid index) and its neighbours along
+ * the ring move towards it. The ring starts with a few neurons and is
+ * doubled by inserting midpoints until it has about twice as many neurons
+ * as nodes, then the nodes are visited in the order of their nearest
+ * neuron. The starting node only changes the random sequence.
+ *
+ * Output buffers have to be preallocated
+ * */
+int tsp_solve_som(struct tsp* tsp, int starting_node, int* output_solution, double* output_value);
+
+#endif // TSP_SOM_H_
@@ -2,9 +2,16 @@
 
 #include "eventlog.h"
 #include "tsp.h"
+#include "tsp_candidates.h"
 #include "tsp_greedy.h"
+#include "tourhash.h"
+#include "util.h"
 #include <bits/types/sigset_t.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -14,44 +21,45 @@ int max(int a, int b)
 	return a < b ? b : a;
 }
 
-int tenure_min = 10;
+// parameters used by the solvers started from main, walkers copy them
+struct tenure_params tenure_default = {
+    .min = 10,
+    .fixed_divisor = 10.0,
+    .sin_divisor = 2000,
+    .sin_scale = 20,
+};
 
 void tenure_setmin(int min)
 {
-	tenure_min = min;
+	tenure_default.min = min;
 }
 
-double tenure_fixed_divisor = 10.0;
-
-int tenure_fixed(int nnodes, int iteration)
+int tenure_fixed(const struct tenure_params* params, int nnodes, int iteration)
 {
-	int computed = ((double)nnodes) / tenure_fixed_divisor;
-	return max(computed, tenure_min);
+	int computed = ((double)nnodes) / params->fixed_divisor;
+	return max(computed, params->min);
 }
 
 void tenure_fixed_setdivisor(double divisor)
 {
-	tenure_fixed_divisor = divisor;
+	tenure_default.fixed_divisor = divisor;
 }
 
-int tenure_sin_divisor = 2000;
-int tenure_sin_scale = 20;
-
-int tenure_sin(int nnodes, int iteration)
+int tenure_sin(const struct tenure_params* params, int nnodes, int iteration)
 {
-	double scale = (double)nnodes / tenure_sin_scale;
-	int computed = sin(((double)iteration) / tenure_sin_divisor) * scale + scale * 2;
-	return max(computed, tenure_min);
+	double scale = (double)nnodes / params->sin_scale;
+	int computed = sin(((double)iteration) / params->sin_divisor) * scale + scale * 2;
+	return max(computed, params->min);
 }
 
 void tenure_sin_setscale(int scale)
 {
-	tenure_sin_scale = scale;
+	tenure_default.sin_scale = scale;
 }
 
 void tenure_sin_setdivisor(int divisor)
 {
-	tenure_sin_divisor = divisor;
+	tenure_default.sin_divisor = divisor;
 }
 
 int is_tabu(int* tabu_iteration, int node, int current_iteration, int tenure)
@@ -117,7 +125,7 @@ int tsp_solve_tabu(struct tsp* tsp, tsp_tenure tenure)
 
 	memcpy(current_solution, tsp->solution_permutation, sizeof(int) * tsp->nnodes);
 	eventlog_logdouble("new_current", 0, current_solution_value);
-	eventlog_logdouble("new_incumbent", 0, current_solution_value);
+	tsp_log_incumbent(tsp, 0, current_solution_value);
 
 	int current_iteration = 0;
 	int ten;
@@ -132,7 +140,7 @@ int tsp_solve_tabu(struct tsp* tsp, tsp_tenure tenure)
 			if (tsp_shouldstop(tsp))
 				goto free_solution_buffers;
 			current_iteration++;
-			ten = tenure(tsp->nnodes, current_iteration);
+			ten = tenure(&tenure_default, tsp->nnodes, current_iteration);
 			best_delta = tsp_2opt_findbestswap_no_tabu(tsp, current_solution, &best_i, &best_j,
 								   tabu_iteration, ten, current_iteration);
 			if (best_delta <= 0)
@@ -141,17 +149,17 @@ int tsp_solve_tabu(struct tsp* tsp, tsp_tenure tenure)
 			int isnewbest = tsp_2opt_swap_save(tsp, current_solution, &current_solution_value, best_i,
 							   best_j, best_delta);
 			if (isnewbest)
-				eventlog_logdouble("new_incumbent", current_iteration, current_solution_value);
+				tsp_log_incumbent(tsp, current_iteration, current_solution_value);
 			eventlog_logdouble("new_current", current_iteration, current_solution_value);
 
 			// output this even tho it is not changed in order
 			// to plot a better chart
-			ten = tenure(tsp->nnodes, current_iteration);
+			ten = tenure(&tenure_default, tsp->nnodes, current_iteration);
 			eventlog_logdouble("tenure", current_iteration, ten);
 		}
 
 		// Diversification phase
-		ten = tenure(tsp->nnodes, current_iteration);
+		ten = tenure(&tenure_default, tsp->nnodes, current_iteration);
 		eventlog_logdouble("tenure", current_iteration, ten);
 		/* printf("tenure(%d) = %d\n", current_iteration, ten); */
 		if (is_tabu(tabu_iteration, best_i, current_iteration, ten)) {
@@ -172,3 +180,644 @@ free_solution_buffers:
 	free(current_solution);
 	return 0;
 }
+
+#define EDGE_TABU_PROBES    8
+#define TABU_CANDIDATES     10
+
+/**
+ * Hash table of the iteration in which each edge has been removed.
+ * Probing is bounded, so lookups and insertions are O(1): when no slot is
+ * free, the oldest entry of the probed ones is overwritten.
+ * */
+struct edge_tabu {
+	uint64_t* keys;
+	int* removed_at;
+	int mask;
+};
+
+static int edge_tabu_init(struct edge_tabu* table, int nnodes)
+{
+	int capacity = 64;
+	while (capacity < 4 * nnodes)
+		capacity *= 2;
+	table->mask = capacity - 1;
+	table->keys = calloc(capacity, sizeof(uint64_t));
+	table->removed_at = malloc(sizeof(int) * capacity);
+	if (!table->keys || !table->removed_at)
+		return -1;
+	return 0;
+}
+
+static void edge_tabu_free(struct edge_tabu* table)
+{
+	free(table->keys);
+	free(table->removed_at);
+}
+
+static void edge_tabu_add(struct edge_tabu* table, int a, int b, int iteration)
+{
+	uint64_t key = tourhash_edge(a, b) | 1; // 0 marks an empty slot
+	int slot = (int)(key >> 32) & table->mask;
+	int oldest = slot;
+	for (int p = 0; p < EDGE_TABU_PROBES; p++) {
+		int current = (slot + p) & table->mask;
+		if (table->keys[current] == 0 || table->keys[current] == key) {
+			oldest = current;
+			break;
+		}
+		if (table->removed_at[current] < table->removed_at[oldest])
+			oldest = current;
+	}
+	table->keys[oldest] = key;
+	table->removed_at[oldest] = iteration;
+}
+
+static int edge_tabu_is(const struct edge_tabu* table, int a, int b, int iteration, int tenure)
+{
+	uint64_t key = tourhash_edge(a, b) | 1;
+	int slot = (int)(key >> 32) & table->mask;
+	for (int p = 0; p < EDGE_TABU_PROBES; p++) {
+		int current = (slot + p) & table->mask;
+		if (table->keys[current] == 0)
+			return 0;
+		if (table->keys[current] == key)
+			return iteration - table->removed_at[current] < tenure;
+	}
+	return 0;
+}
+
+struct edge_move {
+	int x;
+	int y;
+	double delta;
+};
+
+/**
+ * Evaluates the 2opt move removing (x, succ x) and (y, succ y) and adding
+ * (x, y) and (succ x, succ y), and keeps it if it is the best admissible one.
+ *
+ * A move is admissible if none of the added edges is tabu, or if it
+ * improves the incumbent (aspiration criterion).
+ * */
+static void edge_move_evaluate(struct tsp* tsp,
+			       const int* solution,
+			       const int* position,
+			       const struct edge_tabu* table,
+			       int x,
+			       int y,
+			       double current_solution_value,
+			       int iteration,
+			       int tenure,
+			       struct edge_move* best)
+{
+	int n = tsp->nnodes;
+	int sx = solution[position[x] + 1 == n ? 0 : position[x] + 1];
+	int sy = solution[position[y] + 1 == n ? 0 : position[y] + 1];
+	if (y == x || y == sx || sy == x)
+		return;
+
+	double delta = tsp->cost_matrix[flatten_coords(x, sx, n)] + tsp->cost_matrix[flatten_coords(y, sy, n)] -
+		       tsp->cost_matrix[flatten_coords(x, y, n)] - tsp->cost_matrix[flatten_coords(sx, sy, n)];
+	if (delta <= best->delta)
+		return;
+
+	if ((edge_tabu_is(table, x, y, iteration, tenure) || edge_tabu_is(table, sx, sy, iteration, tenure)) &&
+	    current_solution_value - delta >= tsp_get_solution_value(tsp) - EPSILON)
+		return;
+
+	best->x = x;
+	best->y = y;
+	best->delta = delta;
+}
+
+#define REACTIVE_INCREASE   1.2
+#define REACTIVE_DECREASE   0.9
+#define REACTIVE_MAX_TOURS  (1 << 22)
+
+/**
+ * Tenure driven by the search itself:
+ * - it grows every time the search goes back to a tour already seen
+ * - it shrinks every time a new incumbent is found
+ * - it also grows when nothing happens for 2 * tenure iterations, and
+ *   once it reaches the maximum it restarts from the minimum
+ * */
+struct reactive_tenure {
+	double tenure;
+	double min;
+	double max;
+	int last_change;
+	int repetitions;
+	struct hashset seen;
+};
+
+static int reactive_init(struct reactive_tenure* reactive, const struct tenure_params* params, int nnodes)
+{
+	reactive->min = fmax(params->min, nnodes / 20.0);
+	reactive->max = nnodes / 2.0;
+	reactive->tenure = nnodes / 10.0;
+	reactive->last_change = 0;
+	reactive->repetitions = 0;
+	return hashset_init(&reactive->seen, nnodes);
+}
+
+static void reactive_free(struct reactive_tenure* reactive)
+{
+	hashset_free(&reactive->seen);
+}
+
+static void reactive_improved(struct reactive_tenure* reactive, int iteration)
+{
+	reactive->tenure = fmax(reactive->tenure * REACTIVE_DECREASE, reactive->min);
+	reactive->last_change = iteration;
+}
+
+/**
+ * returns 1 if the tour has already been visited
+ * */
+static int reactive_update(struct reactive_tenure* reactive, uint64_t hash, int iteration)
+{
+	if (!hashset_insert(&reactive->seen, hash)) {
+		reactive->repetitions++;
+		reactive->tenure = fmin(reactive->tenure * REACTIVE_INCREASE + 1, reactive->max);
+		reactive->last_change = iteration;
+		return 1;
+	}
+
+	if (iteration - reactive->last_change > 2 * reactive->tenure) {
+		if (reactive->tenure >= reactive->max)
+			reactive->tenure = reactive->min;
+		else
+			reactive->tenure = fmin(reactive->tenure * REACTIVE_INCREASE + 1, reactive->max);
+		reactive->last_change = iteration;
+	}
+
+	// forget every tour instead of growing forever
+	if (reactive->seen.size > REACTIVE_MAX_TOURS) {
+		hashset_free(&reactive->seen);
+		hashset_init(&reactive->seen, REACTIVE_MAX_TOURS);
+	}
+	return 0;
+}
+
+/**
+ * State of one edge tabu search. Everything a walker changes is private,
+ * apart from the incumbent in the tsp struct and the shared clock used
+ * as time instant in the eventlog.
+ * */
+struct tabu_walker {
+	struct tsp* tsp;
+	const struct candidates* cand;
+	tsp_tenure tenure; // NULL if the tenure is reactive
+	struct tenure_params params;
+	struct reactive_tenure reactive;
+	struct edge_tabu table;
+	struct rng rng;
+	atomic_int* clock;
+
+	int* current_solution;
+	int* position;
+	double current_solution_value;
+	uint64_t hash;
+	int iteration;
+
+	// best tour since the last restart
+	int* best_solution;
+	double best_solution_value;
+	int last_improvement;
+};
+
+static int walker_init(struct tabu_walker* walker,
+		       struct tsp* tsp,
+		       const struct candidates* cand,
+		       tsp_tenure tenure,
+		       const struct tenure_params* params,
+		       uint64_t seed,
+		       atomic_int* clock)
+{
+	int n = tsp->nnodes;
+	memset(walker, 0, sizeof(struct tabu_walker));
+	walker->tsp = tsp;
+	walker->cand = cand;
+	walker->tenure = tenure;
+	walker->params = *params;
+	walker->clock = clock;
+	rng_seed(&walker->rng, seed);
+
+	walker->current_solution = malloc(sizeof(int) * n);
+	walker->position = malloc(sizeof(int) * n);
+	walker->best_solution = malloc(sizeof(int) * n);
+	if (!walker->current_solution || !walker->position || !walker->best_solution)
+		return -1;
+	if (edge_tabu_init(&walker->table, n))
+		return -1;
+	if (reactive_init(&walker->reactive, &walker->params, n))
+		return -1;
+	return 0;
+}
+
+static void walker_free(struct tabu_walker* walker)
+{
+	free(walker->current_solution);
+	free(walker->position);
+	free(walker->best_solution);
+	edge_tabu_free(&walker->table);
+	reactive_free(&walker->reactive);
+}
+
+/**
+ * Start the walker from a new tour, forgetting the tabu attributes
+ * */
+static void walker_restart(struct tabu_walker* walker, const int* solution, double value)
+{
+	int n = walker->tsp->nnodes;
+	memcpy(walker->current_solution, solution, sizeof(int) * n);
+	for (int i = 0; i < n; i++)
+		walker->position[solution[i]] = i;
+	walker->current_solution_value = value;
+	walker->hash = tourhash_compute(solution, n);
+
+	memset(walker->table.keys, 0, sizeof(uint64_t) * (walker->table.mask + 1));
+	memcpy(walker->best_solution, solution, sizeof(int) * n);
+	walker->best_solution_value = value;
+	walker->last_improvement = walker->iteration;
+	hashset_insert(&walker->reactive.seen, walker->hash);
+}
+
+/**
+ * One iteration of the edge tabu search.
+ *
+ * returns 1 if the best tour of the walker has improved
+ * */
+static int walker_step(struct tabu_walker* walker)
+{
+	struct tsp* tsp = walker->tsp;
+	const struct candidates* cand = walker->cand;
+	int n = tsp->nnodes;
+	int* current_solution = walker->current_solution;
+	int* position = walker->position;
+	int reactive = walker->tenure == NULL;
+
+	walker->iteration++;
+	int current_iteration = walker->iteration;
+	int instant = atomic_fetch_add(walker->clock, 1) + 1;
+	int ten = reactive ? (int)walker->reactive.tenure : walker->tenure(&walker->params, n, current_iteration);
+
+	// each move adds an edge (x, c) with c candidate of x, in one of
+	// the two orientations: O(n k) moves per iteration
+	struct edge_move best = {.x = -1, .y = -1, .delta = -10e30};
+	for (int x = 0; x < n; x++) {
+		int px = current_solution[position[x] == 0 ? n - 1 : position[x] - 1];
+		for (int k = cand->offset[x]; k < cand->offset[x + 1]; k++) {
+			int c = cand->nodes[k];
+			int pc = current_solution[position[c] == 0 ? n - 1 : position[c] - 1];
+			edge_move_evaluate(tsp, current_solution, position, &walker->table, x, c,
+					   walker->current_solution_value, current_iteration, ten, &best);
+			edge_move_evaluate(tsp, current_solution, position, &walker->table, px, pc,
+					   walker->current_solution_value, current_iteration, ten, &best);
+		}
+	}
+	if (best.x == -1)
+		return 0; // every move is tabu
+
+	int i = position[best.x];
+	int j = position[best.y];
+	int sx = current_solution[i + 1 == n ? 0 : i + 1];
+	int sy = current_solution[j + 1 == n ? 0 : j + 1];
+	edge_tabu_add(&walker->table, best.x, sx, current_iteration);
+	edge_tabu_add(&walker->table, best.y, sy, current_iteration);
+
+	if (i < j)
+		tsp_2opt_swap_pos(i, j, current_solution, position, n);
+	else
+		tsp_2opt_swap_pos(j, i, current_solution, position, n);
+	walker->current_solution_value -= best.delta;
+	walker->hash +=
+	    tourhash_edge(best.x, best.y) + tourhash_edge(sx, sy) - tourhash_edge(best.x, sx) - tourhash_edge(best.y, sy);
+
+	if (reactive && reactive_update(&walker->reactive, walker->hash, current_iteration))
+		eventlog_logdouble("repetition", instant, walker->reactive.repetitions);
+
+	int improved = 0;
+	if (walker->current_solution_value < walker->best_solution_value - EPSILON) {
+		memcpy(walker->best_solution, current_solution, sizeof(int) * n);
+		walker->best_solution_value = walker->current_solution_value;
+		walker->last_improvement = current_iteration;
+		improved = 1;
+		if (tsp_save_solution_shared(tsp, current_solution, walker->current_solution_value, instant) &&
+		    reactive)
+			reactive_improved(&walker->reactive, current_iteration);
+	}
+	eventlog_logdouble("new_current", instant, walker->current_solution_value);
+	eventlog_logdouble("tenure", instant, ten);
+	return improved;
+}
+
+/**
+ * Builds the starting tour of a walker with the greedy heuristic
+ * */
+static int walker_start_greedy(struct tabu_walker* walker, int starting_node)
+{
+#ifdef DEBUG
+	fprintf(stderr, "starting from node %d\n", starting_node);
+#endif
+	double value;
+	if (tsp_solve_greedy(walker->tsp, starting_node, walker->best_solution, &value))
+		return -1;
+	walker_restart(walker, walker->best_solution, value);
+	tsp_save_solution_shared(walker->tsp, walker->current_solution, value, 0);
+	eventlog_logdouble("new_current", 0, value);
+	return 0;
+}
+
+/**
+ * If tenure is NULL the tenure is reactive
+ * */
+static int tabu_edges(struct tsp* tsp, tsp_tenure tenure)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 5)
+		return -1;
+
+	struct candidates cand;
+	if (candidates_build(tsp, TABU_CANDIDATES, &cand))
+		return -1;
+
+	int res = 0;
+	atomic_int clock;
+	atomic_init(&clock, 0);
+	struct tabu_walker walker;
+	if (walker_init(&walker, tsp, &cand, tenure, &tenure_default, tsp->seed, &clock)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	// starting solution is solved with a greedy approach
+	tsp->solution_value = 10e30;
+	if (walker_start_greedy(&walker, rand() % tsp->nnodes)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	tsp_starttimer(tsp);
+
+	while (!tsp_shouldstop(tsp))
+		walker_step(&walker);
+
+	if (tenure == NULL)
+		fprintf(stderr, "Repetitions: %d, final tenure: %d\n", walker.reactive.repetitions,
+			(int)walker.reactive.tenure);
+
+free_buffers:
+	walker_free(&walker);
+	candidates_free(&cand);
+	return res;
+}
+
+int tsp_solve_tabu_edges(struct tsp* tsp, tsp_tenure tenure)
+{
+	return tabu_edges(tsp, tenure);
+}
+
+int tsp_solve_tabu_reactive(struct tsp* tsp)
+{
+	return tabu_edges(tsp, NULL);
+}
+
+#define ELITE_POOL_SIZE        8
+#define WALKER_SYNC_ITERATIONS 100
+#define WALKER_RESTART_KICKS   3
+
+/**
+ * Best tours published by the walkers, without duplicates
+ * */
+struct elite_pool {
+	pthread_mutex_t lock;
+	int nnodes;
+	int size;
+	int* solutions;
+	double* values;
+	uint64_t* hashes;
+};
+
+static int pool_init(struct elite_pool* pool, int nnodes)
+{
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->nnodes = nnodes;
+	pool->size = 0;
+	pool->solutions = malloc(sizeof(int) * nnodes * ELITE_POOL_SIZE);
+	pool->values = malloc(sizeof(double) * ELITE_POOL_SIZE);
+	pool->hashes = malloc(sizeof(uint64_t) * ELITE_POOL_SIZE);
+	if (!pool->solutions || !pool->values || !pool->hashes)
+		return -1;
+	return 0;
+}
+
+static void pool_free(struct elite_pool* pool)
+{
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->solutions);
+	free(pool->values);
+	free(pool->hashes);
+}
+
+/**
+ * Adds the tour if it is not in the pool, replacing the worst one when
+ * the pool is full
+ * */
+static void pool_publish(struct elite_pool* pool, const int* solution, double value)
+{
+	uint64_t hash = tourhash_compute(solution, pool->nnodes);
+
+	pthread_mutex_lock(&pool->lock);
+	int worst = 0;
+	for (int i = 0; i < pool->size; i++) {
+		if (pool->hashes[i] == hash)
+			goto unlock;
+		if (pool->values[i] > pool->values[worst])
+			worst = i;
+	}
+
+	int slot;
+	if (pool->size < ELITE_POOL_SIZE)
+		slot = pool->size++;
+	else if (value < pool->values[worst])
+		slot = worst;
+	else
+		goto unlock;
+
+	memcpy(pool->solutions + slot * pool->nnodes, solution, sizeof(int) * pool->nnodes);
+	pool->values[slot] = value;
+	pool->hashes[slot] = hash;
+
+unlock:
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Copies a random tour of the pool in solution.
+ *
+ * returns -1 if the pool is empty
+ * */
+static int pool_pick(struct elite_pool* pool, struct rng* rng, int* solution, double* value)
+{
+	int res = -1;
+	pthread_mutex_lock(&pool->lock);
+	if (pool->size > 0) {
+		int slot = rng_randint(rng, pool->size);
+		memcpy(solution, pool->solutions + slot * pool->nnodes, sizeof(int) * pool->nnodes);
+		*value = pool->values[slot];
+		res = 0;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return res;
+}
+
+struct parallel_tabu_context {
+	struct tsp* tsp;
+	struct elite_pool* pool;
+	struct tabu_walker* walker;
+	int failed;
+};
+
+static void* parallel_tabu_worker(void* arg)
+{
+	struct parallel_tabu_context* ctx = arg;
+	struct tabu_walker* walker = ctx->walker;
+	struct tsp* tsp = ctx->tsp;
+	int n = tsp->nnodes;
+	int* restart_solution = malloc(sizeof(int) * n);
+	// a walker is stalled if its best tour doesn't improve for this long
+	int stall_iterations = 2 * n;
+	int restarts = 0;
+
+	if (walker_start_greedy(walker, rng_randint(&walker->rng, n))) {
+		ctx->failed = 1;
+		goto free_worker_buffers;
+	}
+
+	while (!tsp_shouldstop(tsp)) {
+		walker_step(walker);
+
+		if (walker->iteration % WALKER_SYNC_ITERATIONS == 0)
+			pool_publish(ctx->pool, walker->best_solution, walker->best_solution_value);
+
+		if (walker->iteration - walker->last_improvement > stall_iterations) {
+			pool_publish(ctx->pool, walker->best_solution, walker->best_solution_value);
+			double value;
+			if (pool_pick(ctx->pool, &walker->rng, restart_solution, &value))
+				continue;
+			// a few random 2opt moves, so that walkers restarted from the
+			// same tour don't follow the same trajectory
+			int* position = walker->position;
+			for (int i = 0; i < n; i++)
+				position[restart_solution[i]] = i;
+			for (int k = 0; k < WALKER_RESTART_KICKS; k++) {
+				int i = rng_randint(&walker->rng, n - 3);
+				int j = i + 2 + rng_randint(&walker->rng, n - i - 3);
+				tsp_2opt_swap_pos(i, j, restart_solution, position, n);
+			}
+			value = tsp_recompute_solution_arg(tsp, restart_solution);
+			walker_restart(walker, restart_solution, value);
+			restarts++;
+			eventlog_logdouble("restart", atomic_load(walker->clock), value);
+		}
+	}
+
+#ifdef DEBUG
+	fprintf(stderr, "Walker: %d iterations, %d restarts, best %lf\n", walker->iteration, restarts,
+		walker->best_solution_value);
+#endif
+
+free_worker_buffers:
+	free(restart_solution);
+	return NULL;
+}
+
+int tsp_solve_tabu_parallel(struct tsp* tsp, tsp_tenure tenure)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 5)
+		return -1;
+
+	int res = 0;
+	int nwalkers = tsp_getnthreads(tsp);
+	struct candidates cand;
+	if (candidates_build(tsp, TABU_CANDIDATES, &cand))
+		return -1;
+
+	struct elite_pool pool;
+	struct tabu_walker* walkers = calloc(nwalkers, sizeof(struct tabu_walker));
+	struct parallel_tabu_context* contexts = calloc(nwalkers, sizeof(struct parallel_tabu_context));
+	pthread_t* threads = malloc(sizeof(pthread_t) * nwalkers);
+	atomic_int clock;
+	atomic_init(&clock, 0);
+
+	if (pool_init(&pool, tsp->nnodes)) {
+		res = -1;
+		goto free_buffers;
+	}
+
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+	int initialized = 0;
+	for (; initialized < nwalkers; initialized++) {
+		// the first walker uses the given parameters, the others perturb
+		// them to diversify the search
+		struct tenure_params params = tenure_default;
+		if (initialized > 0) {
+			double factor = 0.5 + rng_random01(&rng);
+			params.fixed_divisor *= factor;
+			params.sin_scale = params.sin_scale * factor + 1;
+			params.sin_divisor = params.sin_divisor * factor + 1;
+		}
+		if (walker_init(&walkers[initialized], tsp, &cand, tenure, &params, rng_next(&rng), &clock)) {
+			walker_free(&walkers[initialized]);
+			res = -1;
+			goto free_walkers;
+		}
+		contexts[initialized].tsp = tsp;
+		contexts[initialized].pool = &pool;
+		contexts[initialized].walker = &walkers[initialized];
+	}
+
+	tsp->solution_value = 10e30;
+	tsp_starttimer(tsp);
+
+	int started = 0;
+	for (; started < nwalkers; started++) {
+		if (pthread_create(&threads[started], NULL, parallel_tabu_worker, &contexts[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (started == 0)
+		res = -1;
+	for (int i = 0; i < started; i++) {
+		if (contexts[i].failed)
+			res = -1;
+	}
+
+free_walkers:
+	for (int i = 0; i < initialized; i++)
+		walker_free(&walkers[i]);
+	pool_free(&pool);
+free_buffers:
+	free(threads);
+	free(contexts);
+	free(walkers);
+	candidates_free(&cand);
+	return res;
+}
@@ -4,15 +4,26 @@
 #include "tsp.h"
 
 // TENURES
-typedef int (*tsp_tenure)(int nnodes, int iteration);
+struct tenure_params {
+	int min;
+	double fixed_divisor;
+	int sin_divisor;
+	int sin_scale;
+};
 
+typedef int (*tsp_tenure)(const struct tenure_params* params, int nnodes, int iteration);
+
+/**
+ * The setters change the default parameters, used by the solvers and
+ * copied by each walker of the parallel tabu search
+ * */
 void tenure_setmin(int min);
 
-int tenure_fixed(int nnodes, int iteration);
+int tenure_fixed(const struct tenure_params* params, int nnodes, int iteration);
 
 void tenure_fixed_setdivisor(double divisor);
 
-int tenure_sin(int nnodes, int iteration);
+int tenure_sin(const struct tenure_params* params, int nnodes, int iteration);
 
 void tenure_sin_setscale(int scale);
 void tenure_sin_setdivisor(int divisor);
@@ -22,6 +33,39 @@ void tenure_sin_setdivisor(int divisor);
  * This function runs forever.
  * */
 int tsp_solve_tabu(struct tsp* tsp, tsp_tenure tenure);
+
+/**
+ * Solve a tsp instance using a tabu search on 2opt moves where the tabu
+ * attributes are the removed edges: an edge can't be added back for
+ * tenure iterations, unless the move improves the incumbent (aspiration).
+ *
+ * Only the moves adding an edge between a node and one of its candidate
+ * neighbours are evaluated, so each iteration costs O(n k).
+ * This function runs until the time limit.
+ * */
+int tsp_solve_tabu_edges(struct tsp* tsp, tsp_tenure tenure);
+
+/**
+ * Same as tsp_solve_tabu_edges, with a reactive tenure: the visited tours
+ * are recognized through a hash of their edges, updated in O(1) per move.
+ * The tenure grows when a tour is visited again or the search stagnates,
+ * and shrinks when the incumbent improves.
+ * */
+int tsp_solve_tabu_reactive(struct tsp* tsp);
+
+/**
+ * Runs tsp_getnthreads() independent edge tabu walkers, each in its own
+ * thread, starting from different greedy tours and with its own copy of
+ * the tenure parameters (perturbed for all walkers but the first).
+ *
+ * The walkers periodically publish their best tour to a shared elite
+ * pool; a walker that doesn't improve for 2n iterations restarts from a
+ * random (slightly kicked) member of the pool.
+ *
+ * If tenure is NULL every walker uses the reactive tenure.
+ * */
+int tsp_solve_tabu_parallel(struct tsp* tsp, tsp_tenure tenure);
+
 int is_tabu(int* tabu_iteration, int node, int current_iteration, int tenure);
 double tsp_2opt_findbestswap_no_tabu(struct tsp* tsp,
 				     int* solution,
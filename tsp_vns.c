@@ -1,11 +1,17 @@
 #include "tsp_vns.h"
+#include "chrono.h"
 #include "eventlog.h"
 #include "tsp.h"
+#include "tsp_candidates.h"
 #include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define VNS_CANDIDATES 10
+
 int lower = 1;
 int upper = 3;
 
@@ -15,6 +21,13 @@ void vns_setrange(int min, int max)
 	upper = max;
 }
 
+int accept_worse = 1;
+
+void vns_setacceptworse(int accept)
+{
+	accept_worse = accept;
+}
+
 int compar(const void* a, const void* b)
 {
 	return *((int*)a) - *((int*)b);
@@ -36,36 +49,159 @@ void generate_3opt_positions(struct tsp* tsp, int* positions)
 	}
 }
 
-void tsp_3opt_swap(int* positions, int* current_solution, int* new_solution, int size)
+/**
+ * Cost change of the kick: removes the edges after positions i, j and k
+ * and adds (i, j), (i + 1, k), (j + 1, k + 1).
+ * Positive if the tour becomes longer
+ * */
+double tsp_3opt_delta(struct tsp* tsp, int* positions, int* solution)
+{
+	int n = tsp->nnodes;
+	int a = solution[positions[0]], an = solution[positions[0] + 1];
+	int b = solution[positions[1]], bn = solution[positions[1] + 1];
+	int c = solution[positions[2]], cn = solution[positions[2] + 1];
+
+	double removed = tsp->cost_matrix[flatten_coords(a, an, n)] + tsp->cost_matrix[flatten_coords(b, bn, n)] +
+			 tsp->cost_matrix[flatten_coords(c, cn, n)];
+	double added = tsp->cost_matrix[flatten_coords(a, b, n)] + tsp->cost_matrix[flatten_coords(an, c, n)] +
+		       tsp->cost_matrix[flatten_coords(bn, cn, n)];
+	return added - removed;
+}
+
+/**
+ * Applies the kick in place, reversing the segments [i + 1, j] and [j + 1, k]
+ * as two 2opt moves, and marks its endpoints as dirty
+ * */
+void tsp_3opt_swap(int* positions, int* solution, int* position, int nnodes, struct local_search* ls)
 {
-	memcpy(new_solution, current_solution, sizeof(int) * (positions[0] + 1)); // elements from 0 to i
+	int a = solution[positions[0]], an = solution[positions[0] + 1];
+	int b = solution[positions[1]], bn = solution[positions[1] + 1];
+	int c = solution[positions[2]], cn = solution[positions[2] + 1];
 
-	int pos = positions[0] + 1;
-	int z = positions[1];
-	// elements from j to i + 1
-	while (z >= positions[0] + 1) {
-		new_solution[pos++] = current_solution[z--];
+	// remove (a, an), (b, bn), add (a, b), (an, bn)
+	local_search_swap(ls, positions[0], positions[1], solution, position);
+
+	// remove (an, bn), (c, cn), add (an, c), (bn, cn). The first move may
+	// have reversed the other side of the tour, flipping the orientation
+	int i, j;
+	if (solution[position[an] + 1 == nnodes ? 0 : position[an] + 1] == bn) {
+		i = position[an];
+		j = position[c];
+	} else {
+		i = position[bn];
+		j = position[cn];
 	}
+	local_search_swap(ls, i < j ? i : j, i < j ? j : i, solution, position);
+
+	local_search_push(ls, a);
+	local_search_push(ls, an);
+	local_search_push(ls, b);
+	local_search_push(ls, bn);
+	local_search_push(ls, c);
+	local_search_push(ls, cn);
+}
 
-	z = positions[2];
-	while (z >= positions[1] + 1) {
-		new_solution[pos++] = current_solution[z--];
+/**
+ * Cost change of the double bridge kick: the segments [i + 1, j] and
+ * [j + 1, k] are exchanged, adding (i, j + 1), (k, i + 1), (j, k + 1)
+ * */
+double tsp_doublebridge_delta(struct tsp* tsp, int* positions, int* solution)
+{
+	int n = tsp->nnodes;
+	int a = solution[positions[0]], an = solution[positions[0] + 1];
+	int b = solution[positions[1]], bn = solution[positions[1] + 1];
+	int c = solution[positions[2]], cn = solution[positions[2] + 1];
+
+	double removed = tsp->cost_matrix[flatten_coords(a, an, n)] + tsp->cost_matrix[flatten_coords(b, bn, n)] +
+			 tsp->cost_matrix[flatten_coords(c, cn, n)];
+	double added = tsp->cost_matrix[flatten_coords(a, bn, n)] + tsp->cost_matrix[flatten_coords(c, an, n)] +
+		       tsp->cost_matrix[flatten_coords(b, cn, n)];
+	return added - removed;
+}
+
+/**
+ * Applies the double bridge in place with three reversals:
+ * B C -> C' B' -> C B
+ * */
+void tsp_doublebridge_swap(int* positions, int* solution, int* position, struct local_search* ls)
+{
+	for (int i = 0; i < 3; i++) {
+		local_search_push(ls, solution[positions[i]]);
+		local_search_push(ls, solution[positions[i] + 1]);
 	}
 
-	memcpy(new_solution + pos, current_solution + positions[2] + 1, sizeof(int) * (size - positions[2] - 1));
+	int csize = positions[2] - positions[1];
+	local_search_reverse(ls, positions[0] + 1, positions[2], solution, position);
+	local_search_reverse(ls, positions[0] + 1, positions[0] + csize, solution, position);
+	local_search_reverse(ls, positions[0] + csize + 1, positions[2], solution, position);
 }
 
-double compute_solution_value(struct tsp* tsp, int* solution)
+#define VNS_KICK_3OPT         0
+#define VNS_KICK_DOUBLEBRIDGE 1
+#define VNS_KICK_TYPES        2
+
+// number of kicks of each arm of the adaptive vns
+static const int vns_strengths[] = {1, 2, 4, 8};
+#define VNS_STRENGTHS (sizeof(vns_strengths) / sizeof(vns_strengths[0]))
+#define VNS_ARMS      (VNS_KICK_TYPES * VNS_STRENGTHS)
+
+// weight of the last iteration in the statistics of an arm
+#define VNS_ADAPTIVE_ALPHA   0.05
+#define VNS_ADAPTIVE_EXPLORE 0.1
+
+/**
+ * Statistics of a (kick type, strength) pair, as exponential moving
+ * averages over the iterations that used it
+ * */
+struct vns_arm {
+	int pulls;
+	double success;	  // fraction of iterations ending in a better local optimum
+	double gain_rate; // improvement of the local optimum per second
+};
+
+/**
+ * epsilon greedy on the improvement per second, every arm is tried once
+ * */
+static int vns_choose_arm(struct vns_arm* arms, struct rng* rng)
 {
-	double solution_value = 0;
-	for (int i = 0; i < tsp->nnodes - 1; i++) {
-		solution_value += tsp->cost_matrix[flatten_coords(solution[i], solution[i + 1], tsp->nnodes)];
+	int best = 0;
+	for (int i = 0; i < VNS_ARMS; i++) {
+		if (arms[i].pulls == 0)
+			return i;
+		if (arms[i].gain_rate > arms[best].gain_rate)
+			best = i;
 	}
-	solution_value += tsp->cost_matrix[flatten_coords(solution[0], solution[tsp->nnodes - 1], tsp->nnodes)];
-	return solution_value;
+	if (rng_random01(rng) < VNS_ADAPTIVE_EXPLORE)
+		return rng_randint(rng, VNS_ARMS);
+	return best;
 }
 
-int tsp_solve_vns(struct tsp* tsp)
+/**
+ * Update the statistics of arms[i] and log them as arm<i>_success and
+ * arm<i>_gain_rate
+ * */
+static void vns_update_arm(struct vns_arm* arms, int i, double gain, double seconds, int timeinstant)
+{
+	struct vns_arm* arm = &arms[i];
+	double rate = gain > 0 && seconds > 0 ? gain / seconds : 0;
+	double success = gain > 0 ? 1 : 0;
+	if (arm->pulls == 0) {
+		arm->gain_rate = rate;
+		arm->success = success;
+	} else {
+		arm->gain_rate += VNS_ADAPTIVE_ALPHA * (rate - arm->gain_rate);
+		arm->success += VNS_ADAPTIVE_ALPHA * (success - arm->success);
+	}
+	arm->pulls++;
+
+	char event[32];
+	snprintf(event, sizeof(event), "arm%d_success", i);
+	eventlog_logdouble(event, timeinstant, arm->success);
+	snprintf(event, sizeof(event), "arm%d_gain_rate", i);
+	eventlog_logdouble(event, timeinstant, arm->gain_rate);
+}
+
+static int vns(struct tsp* tsp, int adaptive)
 {
 	if (tsp_allocate_solution(tsp))
 		return -1;
@@ -82,55 +218,119 @@ int tsp_solve_vns(struct tsp* tsp)
 	fprintf(stderr, "starting from node %d\n", starting_node);
 	tsp_solve_greedy(tsp, starting_node, tsp->solution_permutation, &tsp->solution_value);
 
+	int res = 0;
 	int* current_solution = malloc(tsp->nnodes * sizeof(int));
+	int* position = malloc(tsp->nnodes * sizeof(int));
 	double current_solution_value = tsp->solution_value;
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	struct vns_arm arms[VNS_ARMS] = {0};
+	struct rng rng;
+	rng_seed(&rng, tsp->seed);
+	if (!current_solution || !position || candidates_build(tsp, VNS_CANDIDATES, &cand) ||
+	    local_search_init(&ls, &cand)) {
+		res = -1;
+		goto free_solution_buffers;
+	}
 
 	memcpy(current_solution, tsp->solution_permutation, sizeof(int) * tsp->nnodes);
+	for (int i = 0; i < tsp->nnodes; i++)
+		position[current_solution[i]] = i;
 	eventlog_logdouble("new_current", 0, current_solution_value);
-	eventlog_logdouble("new_incumbent", 0, current_solution_value);
-
-	int* new_solution = (int*)malloc(tsp->nnodes * sizeof(int));
+	tsp_log_incumbent(tsp, 0, current_solution_value);
 
 	int current_iteration = 0;
+	int arm = -1;
+	double previous_optimum = 0;
+	double kick_start = 0;
 
 	tsp_starttimer(tsp);
 
+	// the first descent starts from every node, the others only from the
+	// endpoints of the kicks
+	local_search_push_all(&ls);
 	while (1) {
 		// Intensification phase
-		while (1) {
-			if (tsp_shouldstop(tsp))
-				goto free_solution_buffers;
-			current_iteration++;
-			int best_i, best_j;
-			double best_delta = tsp_2opt_findbestswap(tsp, current_solution, &best_i, &best_j);
-
-			if (best_delta <= 0)
-				break; // local minimum
-
-			int isnewbest = tsp_2opt_swap_save(tsp, current_solution, &current_solution_value, best_i,
-							   best_j, best_delta);
-			if (isnewbest)
-				eventlog_logdouble("new_incumbent", current_iteration, current_solution_value);
+		current_iteration++;
+		local_search_2opt(tsp, &ls, current_solution, position, &current_solution_value);
+		if (current_solution_value < tsp->solution_value - EPSILON) {
+			tsp_save_solution(tsp, current_solution, current_solution_value);
+			tsp_log_incumbent(tsp, current_iteration, current_solution_value);
+		}
+		eventlog_logdouble("new_current", current_iteration, current_solution_value);
+
+		if (arm >= 0)
+			vns_update_arm(arms, arm, previous_optimum - current_solution_value, second() - kick_start,
+				       current_iteration);
+
+		if (ls.journaling && current_solution_value > previous_optimum + EPSILON) {
+			// back to the previous local optimum
+			local_search_undo(&ls, current_solution, position);
+			current_solution_value = previous_optimum;
 			eventlog_logdouble("new_current", current_iteration, current_solution_value);
 		}
+		local_search_commit(&ls);
+		ls.journaling = !accept_worse;
+
+		if (tsp_shouldstop(tsp))
+			break;
 
 		// Diversification phase
+		previous_optimum = current_solution_value;
 		int positions[3];
-		int r = (rand() % (upper - lower + 1)) + lower;
+		int type = VNS_KICK_3OPT;
+		int r;
+		if (adaptive) {
+			arm = vns_choose_arm(arms, &rng);
+			type = arm / VNS_STRENGTHS;
+			r = vns_strengths[arm % VNS_STRENGTHS];
+			kick_start = second();
+			eventlog_logdouble("kick_type", current_iteration, type);
+			eventlog_logdouble("kick_strength", current_iteration, r);
+		} else {
+			r = (rand() % (upper - lower + 1)) + lower;
+		}
 		// do 3opt [UPPER, LOWER] times
 		for (int i = 0; i < r; i++) {
 			generate_3opt_positions(tsp, positions); // i -> j -> k
-			tsp_3opt_swap(positions, current_solution, new_solution, tsp->nnodes);
-			memcpy(current_solution, new_solution, sizeof(int) * tsp->nnodes);
+			if (type == VNS_KICK_3OPT) {
+				current_solution_value += tsp_3opt_delta(tsp, positions, current_solution);
+				tsp_3opt_swap(positions, current_solution, position, tsp->nnodes, &ls);
+			} else {
+				current_solution_value += tsp_doublebridge_delta(tsp, positions, current_solution);
+				tsp_doublebridge_swap(positions, current_solution, position, &ls);
+			}
 		}
 		// now we are considering all the kicks as a single move.
 		// consider moving the instruction below into the cycle to count them as
 		// different moves
-		current_solution_value = compute_solution_value(tsp, current_solution);
 		eventlog_logdouble("new_current", current_iteration, current_solution_value);
 	}
+
+	double elapsed = tsp_getelapsedseconds(tsp);
+	fprintf(stderr, "Kicks: %d in %lf s (%lf/s)\n", current_iteration - 1, elapsed,
+		elapsed > 0 ? (current_iteration - 1) / elapsed : 0);
+	if (adaptive) {
+		for (int i = 0; i < VNS_ARMS; i++)
+			fprintf(stderr, "Kick %s x%d: pulls %d, success %lf, gain %lf/s\n",
+				i / VNS_STRENGTHS == VNS_KICK_3OPT ? "3opt" : "double bridge",
+				vns_strengths[i % VNS_STRENGTHS], arms[i].pulls, arms[i].success, arms[i].gain_rate);
+	}
+
 free_solution_buffers:
-	free(new_solution);
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
 	free(current_solution);
-	return 0;
+	return res;
+}
+
+int tsp_solve_vns(struct tsp* tsp)
+{
+	return vns(tsp, 0);
+}
+
+int tsp_solve_vns_adaptive(struct tsp* tsp)
+{
+	return vns(tsp, 1);
 }
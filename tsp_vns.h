@@ -2,15 +2,45 @@
 #define TSP_VNS_
 
 #include "tsp.h"
+#include "tsp_localsearch.h"
 
 /**
  * Solve a tsp instance using the vns method
  * */
 int tsp_solve_vns(struct tsp* tsp);
 
+/**
+ * Solve a tsp instance using the vns method, choosing the kick type
+ * (3opt or double bridge) and the number of kicks online from their
+ * recent improvement per second. Ignores vns_setrange
+ * */
+int tsp_solve_vns_adaptive(struct tsp* tsp);
+
 /**
  * Set the interval from which the number of kicks is generated
  * */
 void vns_setrange(int min, int max);
 
+/**
+ * If accept is 0 a kick leading to a worse local optimum is undone,
+ * otherwise the search always continues from the new local optimum (default)
+ * */
+void vns_setacceptworse(int accept);
+
+/**
+ * Three random positions i < j < k of a kick, not adjacent
+ * */
+void generate_3opt_positions(struct tsp* tsp, int* positions);
+
+/**
+ * Cost change of the double bridge kick on the given positions
+ * */
+double tsp_doublebridge_delta(struct tsp* tsp, int* positions, int* solution);
+
+/**
+ * Apply the double bridge kick on the given positions, its endpoints are
+ * pushed in ls
+ * */
+void tsp_doublebridge_swap(int* positions, int* solution, int* position, struct local_search* ls);
+
 #endif
@@ -0,0 +1,372 @@
+#include "tsp_window.h"
+#include "tsp.h"
+#include "tsp_candidates.h"
+#include "tsp_greedy.h"
+#include "tsp_localsearch.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WINDOW_CANDIDATES 10
+
+/**
+ * Tables of the dynamic programming on a window, allocated once for each
+ * thread. cost[S * m + j] is the cheapest path from the first node of the
+ * window through the interior nodes in S, ending in interior node j
+ * */
+struct window_dp {
+	int k;
+	double* dist; // k x k costs between the window nodes
+	double* cost;
+	signed char* last; // interior node before j on the cheapest path
+	int nodes[WINDOW_MAX_SIZE];
+};
+
+static int window_dp_init(struct window_dp* dp, int k)
+{
+	int m = k - 2;
+	size_t states = (size_t)1 << m;
+	dp->k = k;
+	dp->dist = malloc(sizeof(double) * k * k);
+	dp->cost = malloc(sizeof(double) * states * m);
+	dp->last = malloc(sizeof(signed char) * states * m);
+	if (!dp->dist || !dp->cost || !dp->last)
+		return -1;
+	return 0;
+}
+
+static void window_dp_free(struct window_dp* dp)
+{
+	free(dp->dist);
+	free(dp->cost);
+	free(dp->last);
+	dp->dist = NULL;
+	dp->cost = NULL;
+	dp->last = NULL;
+}
+
+/**
+ * Reorders dp->nodes[1 ... k - 2] with the cheapest path from dp->nodes[0]
+ * to dp->nodes[k - 1].
+ *
+ * returns the decrease of the cost of the path
+ * */
+static double window_dp_solve(struct window_dp* dp, const struct tsp* tsp)
+{
+	int k = dp->k, m = k - 2;
+	double* dist = dp->dist;
+	for (int a = 0; a < k; a++) {
+		for (int b = 0; b < k; b++)
+			dist[a * k + b] = tsp_cost(tsp, dp->nodes[a], dp->nodes[b]);
+	}
+	double current = 0;
+	for (int a = 0; a + 1 < k; a++)
+		current += dist[a * k + a + 1];
+
+	// interior node j is node j + 1 of the window
+	for (int j = 0; j < m; j++) {
+		dp->cost[((size_t)1 << j) * m + j] = dist[j + 1];
+		dp->last[((size_t)1 << j) * m + j] = -1;
+	}
+	unsigned full = (1u << m) - 1;
+	for (unsigned set = 1; set <= full; set++) {
+		if (!(set & (set - 1)))
+			continue; // single nodes are the base case
+		for (int j = 0; j < m; j++) {
+			if (!(set & (1u << j)))
+				continue;
+			unsigned previous = set ^ (1u << j);
+			const double* row = dp->cost + (size_t)previous * m;
+			double best = INFINITY;
+			int best_i = -1;
+			for (int i = 0; i < m; i++) {
+				if (!(previous & (1u << i)))
+					continue;
+				double c = row[i] + dist[(i + 1) * k + j + 1];
+				if (c < best) {
+					best = c;
+					best_i = i;
+				}
+			}
+			dp->cost[(size_t)set * m + j] = best;
+			dp->last[(size_t)set * m + j] = best_i;
+		}
+	}
+
+	double best = INFINITY;
+	int j = -1;
+	for (int i = 0; i < m; i++) {
+		double c = dp->cost[(size_t)full * m + i] + dist[(i + 1) * k + k - 1];
+		if (c < best) {
+			best = c;
+			j = i;
+		}
+	}
+	if (best >= current - EPSILON)
+		return 0;
+
+	int interior[WINDOW_MAX_SIZE];
+	memcpy(interior, dp->nodes + 1, sizeof(int) * m);
+	unsigned set = full;
+	for (int p = m; p > 0; p--) {
+		dp->nodes[p] = interior[j];
+		int previous = dp->last[(size_t)set * m + j];
+		set ^= 1u << j;
+		j = previous;
+	}
+	return current - best;
+}
+
+struct window_context {
+	struct tsp* tsp;
+	int k;
+	int* solution;
+	int* position;
+
+	int nthreads;
+	int ready;
+	pthread_mutex_t ready_lock;
+	pthread_cond_t ready_cond;
+	pthread_barrier_t barrier;
+
+	// position of the first window of the sweep
+	int base;
+	// decided by the first thread at the end of each phase, alternating
+	// slots so that it is never written while the others read it
+	int stop[2];
+};
+
+struct window_worker {
+	struct window_context* ctx;
+	struct window_dp dp;
+	int id;
+	double gain;
+	int improved;
+	int* improved_starts; // first position of the improved windows
+};
+
+/**
+ * Optimizes the window starting at position start
+ * */
+static void window_optimize_at(struct window_worker* worker, int start)
+{
+	struct window_context* ctx = worker->ctx;
+	int n = ctx->tsp->nnodes;
+	for (int a = 0; a < ctx->k; a++)
+		worker->dp.nodes[a] = ctx->solution[(start + a) % n];
+	double gain = window_dp_solve(&worker->dp, ctx->tsp);
+	if (gain <= 0)
+		return;
+	for (int a = 1; a + 1 < ctx->k; a++) {
+		int p = (start + a) % n;
+		ctx->solution[p] = worker->dp.nodes[a];
+		ctx->position[worker->dp.nodes[a]] = p;
+	}
+	worker->gain += gain;
+	worker->improved_starts[worker->improved++] = start;
+}
+
+static void* window_worker(void* arg)
+{
+	struct window_worker* worker = arg;
+	struct window_context* ctx = worker->ctx;
+	int n = ctx->tsp->nnodes;
+	int stride = ctx->k - 1;
+	// windows of a phase only share their fixed endpoints
+	int windows = n / stride;
+
+	pthread_mutex_lock(&ctx->ready_lock);
+	while (!ctx->ready)
+		pthread_cond_wait(&ctx->ready_cond, &ctx->ready_lock);
+	pthread_mutex_unlock(&ctx->ready_lock);
+
+	for (int offset = 0; offset < stride; offset++) {
+		for (int w = worker->id; w < windows; w += ctx->nthreads)
+			window_optimize_at(worker, (ctx->base + offset + w * stride) % n);
+		if (worker->id == 0)
+			ctx->stop[offset & 1] = tsp_shouldstop(ctx->tsp);
+		pthread_barrier_wait(&ctx->barrier);
+		if (ctx->stop[offset & 1])
+			break;
+	}
+	return NULL;
+}
+
+/**
+ * One sweep of the window along the whole tour
+ * */
+static int window_sweep(struct window_context* ctx, struct window_worker* workers, pthread_t* threads)
+{
+	ctx->ready = 0;
+	int started = 1;
+	for (; started < ctx->nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, window_worker, &workers[started])) {
+			fprintf(stderr, "Can't create thread\n");
+			break;
+		}
+	}
+	int nthreads = ctx->nthreads;
+	ctx->nthreads = started;
+	pthread_barrier_init(&ctx->barrier, NULL, started);
+	pthread_mutex_lock(&ctx->ready_lock);
+	ctx->ready = 1;
+	pthread_cond_broadcast(&ctx->ready_cond);
+	pthread_mutex_unlock(&ctx->ready_lock);
+
+	window_worker(&workers[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_barrier_destroy(&ctx->barrier);
+	ctx->nthreads = nthreads;
+	return 0;
+}
+
+int window_workspace_init(struct window_workspace* ws, const struct tsp* tsp, int k)
+{
+	int n = tsp->nnodes;
+	if (k < 4 || k > WINDOW_MAX_SIZE || k > n)
+		return -1;
+
+	ws->k = k;
+	ws->nthreads = tsp_getnthreads(tsp);
+	ws->workers = calloc(ws->nthreads, sizeof(struct window_worker));
+	ws->threads = malloc(sizeof(pthread_t) * ws->nthreads);
+	if (!ws->workers || !ws->threads) {
+		window_workspace_free(ws);
+		return -1;
+	}
+	for (int i = 0; i < ws->nthreads; i++) {
+		struct window_worker* worker = &ws->workers[i];
+		worker->id = i;
+		worker->improved_starts = malloc(sizeof(int) * (n / (k - 1) + 1) * (k - 1));
+		if (window_dp_init(&worker->dp, k) || !worker->improved_starts) {
+			window_workspace_free(ws);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void window_workspace_free(struct window_workspace* ws)
+{
+	for (int i = 0; ws->workers && i < ws->nthreads; i++) {
+		window_dp_free(&ws->workers[i].dp);
+		free(ws->workers[i].improved_starts);
+	}
+	free(ws->threads);
+	free(ws->workers);
+	ws->threads = NULL;
+	ws->workers = NULL;
+}
+
+int tsp_window_optimize(struct tsp* tsp,
+			struct window_workspace* ws,
+			int* solution,
+			int* position,
+			double* value,
+			struct local_search* ls)
+{
+	int n = tsp->nnodes;
+	int k = ws->k;
+	int nthreads = ws->nthreads;
+	struct window_worker* workers = ws->workers;
+	struct window_context ctx = {
+	    .tsp = tsp,
+	    .k = k,
+	    .solution = solution,
+	    .position = position,
+	    .nthreads = nthreads,
+	};
+	pthread_mutex_init(&ctx.ready_lock, NULL);
+	pthread_cond_init(&ctx.ready_cond, NULL);
+	for (int i = 0; i < nthreads; i++)
+		workers[i].ctx = &ctx;
+
+	int total = 0;
+	while (!tsp_shouldstop(tsp)) {
+		for (int i = 0; i < nthreads; i++) {
+			workers[i].gain = 0;
+			workers[i].improved = 0;
+		}
+		window_sweep(&ctx, workers, ws->threads);
+
+		int improved = 0;
+		for (int i = 0; i < nthreads; i++) {
+			*value -= workers[i].gain;
+			improved += workers[i].improved;
+			if (!ls)
+				continue;
+			for (int w = 0; w < workers[i].improved; w++) {
+				for (int a = 0; a < k; a++)
+					local_search_push(ls, solution[(workers[i].improved_starts[w] + a) % n]);
+			}
+		}
+		total += improved;
+		if (improved == 0)
+			break;
+		// the windows of a sweep don't start in the last n % (k - 1) positions
+		ctx.base = (ctx.base + n / (k - 1) * (k - 1)) % n;
+	}
+
+	pthread_cond_destroy(&ctx.ready_cond);
+	pthread_mutex_destroy(&ctx.ready_lock);
+	return total;
+}
+
+int tsp_solve_window(struct tsp* tsp, int k)
+{
+	if (tsp_allocate_solution(tsp))
+		return -1;
+
+	if (!tsp->cost_matrix)
+		return -1;
+
+	if (tsp->nnodes < 8)
+		return -1;
+
+	int n = tsp->nnodes;
+	int starting_node = rand() % n;
+	fprintf(stderr, "starting from node %d\n", starting_node);
+	tsp_starttimer(tsp);
+	tsp_solve_greedy(tsp, starting_node, tsp->solution_permutation, &tsp->solution_value);
+	tsp_log_incumbent(tsp, 0, tsp->solution_value);
+
+	int res = 0;
+	int* position = malloc(sizeof(int) * n);
+	struct candidates cand = {0};
+	struct local_search ls = {0};
+	struct window_workspace ws = {0};
+	if (!position || candidates_build(tsp, WINDOW_CANDIDATES, &cand) || local_search_init(&ls, &cand) ||
+	    window_workspace_init(&ws, tsp, k)) {
+		res = -1;
+		goto free_buffers;
+	}
+	ls.oropt = 1;
+	for (int i = 0; i < n; i++)
+		position[tsp->solution_permutation[i]] = i;
+
+	local_search_push_all(&ls);
+	int iteration = 0;
+	int windows = 0;
+	while (!tsp_shouldstop(tsp)) {
+		iteration++;
+		local_search_2opt(tsp, &ls, tsp->solution_permutation, position, &tsp->solution_value);
+		tsp_log_incumbent(tsp, iteration, tsp->solution_value);
+		int improved =
+		    tsp_window_optimize(tsp, &ws, tsp->solution_permutation, position, &tsp->solution_value, &ls);
+		tsp_log_incumbent(tsp, iteration, tsp->solution_value);
+		windows += improved;
+		if (improved == 0)
+			break;
+	}
+	fprintf(stderr, "Rounds: %d, improved windows: %d in %lf s\n", iteration, windows, tsp_getelapsedseconds(tsp));
+
+free_buffers:
+	window_workspace_free(&ws);
+	local_search_free(&ls);
+	candidates_free(&cand);
+	free(position);
+	return res;
+}
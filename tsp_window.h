@@ -0,0 +1,57 @@
+#ifndef TSP_WINDOW_H_
+#define TSP_WINDOW_H_
+
+#include "tsp.h"
+#include "tsp_localsearch.h"
+#include <pthread.h>
+
+// 2^(WINDOW_MAX_SIZE - 2) * (WINDOW_MAX_SIZE - 2) entries per table
+#define WINDOW_MAX_SIZE 14
+
+struct window_worker;
+
+/**
+ * Threads and dynamic programming tables of tsp_window_optimize for
+ * windows of k nodes, allocated once and reused by every call
+ * */
+struct window_workspace {
+	int k;
+	int nthreads;
+	struct window_worker* workers;
+	pthread_t* threads;
+};
+
+int window_workspace_init(struct window_workspace* ws, const struct tsp* tsp, int k);
+
+void window_workspace_free(struct window_workspace* ws);
+
+/**
+ * Sweep a window of ws->k consecutive nodes along the tour, replacing the
+ * path between the two endpoints of each window with the optimal one
+ * through the same nodes (bitmask dynamic programming on the k - 2
+ * interior nodes). Costs are read with tsp_cost, so the cost matrix is
+ * not needed.
+ *
+ * The windows of a sweep are processed in k - 1 phases of disjoint
+ * windows, each phase split across tsp_getnthreads() threads. Sweeps are
+ * repeated until one doesn't improve the tour.
+ *
+ * position is kept updated. If ls is not NULL the nodes of the improved
+ * windows are queued in it.
+ *
+ * returns the number of improved windows
+ * */
+int tsp_window_optimize(struct tsp* tsp,
+			struct window_workspace* ws,
+			int* solution,
+			int* position,
+			double* value,
+			struct local_search* ls);
+
+/**
+ * Solve a tsp instance with greedy + 2opt/Or-opt, alternated with window
+ * sweeps of size k until neither improves the tour
+ * */
+int tsp_solve_window(struct tsp* tsp, int k);
+
+#endif // TSP_WINDOW_H_
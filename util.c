@@ -7,6 +7,36 @@ double random01()
 	return ((double)rand() / RAND_MAX);
 }
 
+void rng_seed(struct rng* rng, uint64_t seed)
+{
+	// splitmix64 step, so that close seeds give unrelated states
+	uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+	rng->state = z ? z : 1;
+}
+
+uint64_t rng_next(struct rng* rng)
+{
+	uint64_t x = rng->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	rng->state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+double rng_random01(struct rng* rng)
+{
+	return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int rng_randint(struct rng* rng, int n)
+{
+	return (int)(((rng_next(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
 void print_array_int(int* arr, int size)
 {
 	for (int i = 0; i < size; i++) {
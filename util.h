@@ -1,8 +1,31 @@
 #ifndef UTIL_H_
 #define UTIL_H_
 
+#include <stdint.h>
+
 double random01();
 
+/**
+ * Small xorshift64* generator. Unlike rand() every solver (or thread)
+ * owns its state, so it is reentrant and reproducible.
+ * */
+struct rng {
+	uint64_t state;
+};
+
+void rng_seed(struct rng* rng, uint64_t seed);
+uint64_t rng_next(struct rng* rng);
+
+/**
+ * Uniform in [0, 1)
+ * */
+double rng_random01(struct rng* rng);
+
+/**
+ * Uniform in [0, n)
+ * */
+int rng_randint(struct rng* rng, int n);
+
 void print_array_int(int* arr, int size);
 
 void print_array_double(double* arr, int size);